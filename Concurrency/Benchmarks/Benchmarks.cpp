@@ -0,0 +1,475 @@
+//
+//  Benchmarks.cpp
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+//  Microbenchmarks for the queues, the thread pool and its tracer, the
+//  hash sets and the arena allocator. Every result is printed as one JSON object
+//  per line, so runs can be collected and compared across versions:
+//
+//      concurrency_benchmarks [--quick] [--filter=<substring>] [--threads=<max>]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Blocking Queue/BlockingQueue.h"
+#include "../Thread Pool/ThreadPool.h"
+#include "../Blocking Queue/BoundedMPMCQueue.h"
+#include "../Striped Hash Set/StripedHashSet.h"
+#include "../Optimistic Linked List/arena_allocator.h"
+#include "../Optimistic Linked List/object_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Settings {
+    bool quick = false;
+    std::string filter;
+    std::size_t max_threads = std::max(std::thread::hardware_concurrency(), 2u);
+
+    std::size_t Scale(const std::size_t full) const {
+        return quick ? std::max<std::size_t>(full / 20, 1) : full;
+    }
+
+    // 1, 2, 4, ... up to max_threads, max_threads included.
+    std::vector<std::size_t> ThreadCounts() const {
+        std::vector<std::size_t> counts;
+        for (std::size_t n = 1; n < max_threads; n *= 2)
+            counts.push_back(n);
+        counts.push_back(max_threads);
+        return counts;
+    }
+
+    bool Selected(const std::string& name) const {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+};
+
+// One JSON line: {"benchmark": ..., <fields>}.
+class Result {
+public:
+    explicit Result(const std::string& benchmark) {
+        line = "{\"benchmark\":\"" + benchmark + "\"";
+    }
+
+    Result& Field(const char* key, const std::string& value) {
+        line += std::string(",\"") + key + "\":\"" + value + "\"";
+        return *this;
+    }
+
+    Result& Field(const char* key, const double value) {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+        line += std::string(",\"") + key + "\":" + buffer;
+        return *this;
+    }
+
+    Result& Rate(const std::size_t ops, const double seconds) {
+        Field("ops", static_cast<double>(ops));
+        Field("seconds", seconds);
+        return Field("ops_per_sec", seconds > 0 ? ops / seconds : 0.0);
+    }
+
+    // Latency percentiles of samples in nanoseconds; reorders them.
+    Result& Latency(std::vector<std::uint64_t>& samples) {
+        if (samples.empty())
+            return *this;
+        std::sort(samples.begin(), samples.end());
+        auto at = [&samples](const double q) {
+            return static_cast<double>(samples[std::min(samples.size() - 1, static_cast<std::size_t>(q * samples.size()))]);
+        };
+        Field("p50_ns", at(0.50));
+        Field("p99_ns", at(0.99));
+        return Field("max_ns", static_cast<double>(samples.back()));
+    }
+
+    ~Result() {
+        std::printf("%s}\n", line.c_str());
+        std::fflush(stdout);
+    }
+
+private:
+    std::string line;
+};
+
+static std::uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static double SecondsSince(const Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// xorshift64*: cheap enough not to show up next to the structures.
+class Random {
+public:
+    explicit Random(const std::uint64_t seed): state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+    std::uint64_t Next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    double Uniform() {
+        return (Next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    std::uint64_t state;
+};
+
+// Runs body(thread_index) on num_threads threads released together and
+// returns the wall time from release until the last one finished.
+static double RunThreads(const std::size_t num_threads, const std::function<void(std::size_t)>& body) {
+    std::atomic<std::size_t> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < num_threads; i++)
+        threads.emplace_back([&, i](){
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            body(i);
+        });
+    while (ready.load() != num_threads)
+        std::this_thread::yield();
+
+    const Clock::time_point start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : threads)
+        thread.join();
+    return SecondsSince(start);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Queues: producers put timestamps, consumers record how long each
+// element sat in the queue.
+
+template <class Queue>
+static void BenchmarkQueue(const Settings& settings, const std::string& name, const std::size_t producers, const std::size_t consumers) {
+    const std::size_t items = settings.Scale(2000000) / producers * producers;
+    Queue queue(1024);
+    std::atomic<std::size_t> producers_left(producers);
+    std::vector<std::vector<std::uint64_t>> latencies(consumers);
+
+    const double seconds = RunThreads(producers + consumers, [&](const std::size_t index){
+        if (index < producers) {
+            for (std::size_t i = 0; i < items / producers; i++)
+                queue.Put(NowNs());
+            // The last producer out lets the consumers drain and stop.
+            if (producers_left.fetch_sub(1) == 1)
+                queue.Shutdown();
+            return;
+        }
+        // Every 16th element is sampled; reading the clock for all of
+        // them would be most of what the consumer does.
+        std::vector<std::uint64_t>& samples = latencies[index - producers];
+        std::uint64_t stamp;
+        for (std::size_t received = 0; queue.Get(stamp); received++)
+            if ((received & 0xF) == 0)
+                samples.push_back(NowNs() - stamp);
+    });
+
+    std::vector<std::uint64_t> samples;
+    for (auto& part : latencies)
+        samples.insert(samples.end(), part.begin(), part.end());
+    Result(name).Field("producers", static_cast<double>(producers)).Field("consumers", static_cast<double>(consumers))
+        .Rate(items, seconds).Latency(samples);
+}
+
+static void BenchmarkQueues(const Settings& settings) {
+    const std::size_t half = std::max<std::size_t>(settings.max_threads / 2, 1);
+    if (settings.Selected("blocking_queue")) {
+        BenchmarkQueue<BlockingQueue<std::uint64_t>>(settings, "blocking_queue", 1, 1);
+        BenchmarkQueue<BlockingQueue<std::uint64_t>>(settings, "blocking_queue", half, half);
+    }
+    if (settings.Selected("pooled_list_queue")) {
+        BenchmarkQueue<BlockingQueue<std::uint64_t, std::list<std::uint64_t, PoolAllocator<std::uint64_t>>>>(settings, "pooled_list_queue", 1, 1);
+        BenchmarkQueue<BlockingQueue<std::uint64_t, std::list<std::uint64_t, PoolAllocator<std::uint64_t>>>>(settings, "pooled_list_queue", half, half);
+    }
+    if (settings.Selected("spsc_queue")) {
+        BenchmarkQueue<BlockingQueue<std::uint64_t, SingleProducerSingleConsumer<>>>(settings, "spsc_queue", 1, 1);
+        BenchmarkQueue<BlockingQueue<std::uint64_t, SingleProducerSingleConsumer<SPSCWait::Spin>>>(settings, "spsc_queue_spin", 1, 1);
+    }
+    if (settings.Selected("bounded_mpmc_queue")) {
+        BenchmarkQueue<BoundedMPMCQueue<std::uint64_t>>(settings, "bounded_mpmc_queue", 1, 1);
+        BenchmarkQueue<BoundedMPMCQueue<std::uint64_t>>(settings, "bounded_mpmc_queue", half, half);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// ThreadPool: throughput of empty fire-and-forget tasks, and how long a
+// task waits between Submit and the start of its body.
+
+static void BenchmarkThreadPool(const Settings& settings, const SchedulingMode mode, const char* mode_name) {
+    ThreadPoolOptions options;
+    options.num_threads = settings.max_threads;
+    options.mode = mode;
+    options.queue_capacity = ThreadPoolOptions::kUnboundedQueue;
+    ThreadPool<> pool(options);
+
+    if (settings.Selected("thread_pool_throughput")) {
+        const std::size_t tasks = settings.Scale(2000000);
+        std::atomic<std::size_t> done(0);
+        const Clock::time_point start = Clock::now();
+        for (std::size_t i = 0; i < tasks; i++)
+            pool.Execute([&done](){ done.fetch_add(1, std::memory_order_relaxed); });
+        while (done.load() != tasks)
+            std::this_thread::yield();
+        Result("thread_pool_throughput").Field("mode", mode_name).Field("threads", static_cast<double>(settings.max_threads))
+            .Rate(tasks, SecondsSince(start));
+    }
+
+    if (settings.Selected("thread_pool_nested")) {
+        // Tasks submitted from the workers themselves, the case the
+        // work-stealing deques are built for.
+        const std::size_t tasks = settings.Scale(2000000);
+        const std::size_t fanout = 1000;
+        std::atomic<std::size_t> done(0);
+        const Clock::time_point start = Clock::now();
+        for (std::size_t i = 0; i < tasks / fanout; i++)
+            pool.Execute([&pool, &done, fanout](){
+                for (std::size_t j = 0; j < fanout; j++)
+                    pool.Execute([&done](){ done.fetch_add(1, std::memory_order_relaxed); });
+            });
+        while (done.load() != tasks / fanout * fanout)
+            std::this_thread::yield();
+        Result("thread_pool_nested").Field("mode", mode_name).Field("threads", static_cast<double>(settings.max_threads))
+            .Rate(tasks / fanout * fanout, SecondsSince(start));
+    }
+
+    if (settings.Selected("thread_pool_latency")) {
+        // One task in flight at a time, so this is wake-up latency.
+        const std::size_t tasks = settings.Scale(100000);
+        std::vector<std::uint64_t> samples;
+        samples.reserve(tasks);
+        const Clock::time_point start = Clock::now();
+        for (std::size_t i = 0; i < tasks; i++) {
+            const std::uint64_t submitted = NowNs();
+            samples.push_back(pool.Submit([submitted](){ return NowNs() - submitted; }).get());
+        }
+        Result("thread_pool_latency").Field("mode", mode_name).Field("threads", static_cast<double>(settings.max_threads))
+            .Rate(tasks, SecondsSince(start)).Latency(samples);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// TaskTracer: Submit throughput without a tracer, with one attached but
+// not sampling, and at a few sampling rates.
+
+static void BenchmarkTracing(const Settings& settings) {
+    const std::size_t sample_rates[] = {0, 1000, 100, 1};
+    for (int attached = 0; attached < 5; attached++) {
+        TaskTracer tracer(attached ? sample_rates[attached - 1] : 0);
+        ThreadPoolOptions options;
+        options.num_threads = settings.max_threads;
+        options.queue_capacity = ThreadPoolOptions::kUnboundedQueue;
+        options.tracer = attached ? &tracer : nullptr;
+        ThreadPool<> pool(options);
+
+        const std::size_t tasks = settings.Scale(1000000);
+        std::vector<std::future<std::size_t>> results;
+        results.reserve(tasks);
+        const Clock::time_point start = Clock::now();
+        for (std::size_t i = 0; i < tasks; i++)
+            results.push_back(pool.Submit([i](){ return i; }));
+        for (auto& result : results)
+            result.get();
+        Result("thread_pool_tracing").Field("tracer", attached ? "attached" : "none")
+            .Field("sample_every", static_cast<double>(attached ? sample_rates[attached - 1] : 0))
+            .Rate(tasks, SecondsSince(start));
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// StripedHashSet and SplitOrderedHashSet: a read/write mix over a key
+// range half filled up front. "stride" keys are all multiples of the
+// stripe count, so with std::hash<int> they pile into one stripe.
+
+enum class KeyDistribution { Uniform, Skewed, Stride };
+
+static const char* DistributionName(const KeyDistribution distribution) {
+    switch (distribution) {
+        case KeyDistribution::Uniform: return "uniform";
+        case KeyDistribution::Skewed: return "skewed";
+        case KeyDistribution::Stride: return "stride";
+    }
+    return "";
+}
+
+static const std::size_t kStripes = 64;
+static const std::size_t kKeyRange = 1 << 16;
+
+static int NextKey(Random& random, const KeyDistribution distribution) {
+    switch (distribution) {
+        case KeyDistribution::Uniform:
+            return static_cast<int>(random.Next() % kKeyRange);
+        case KeyDistribution::Skewed: {
+            // Power law: a few hundred keys take most of the traffic.
+            const double u = random.Uniform();
+            return static_cast<int>(u * u * u * u * kKeyRange);
+        }
+        case KeyDistribution::Stride:
+            return static_cast<int>((random.Next() % kKeyRange) * kStripes);
+    }
+    return 0;
+}
+
+template <class Set>
+static void BenchmarkHashSet(const Settings& settings, const char* benchmark, const char* buckets_name) {
+    const KeyDistribution distributions[] = {KeyDistribution::Uniform, KeyDistribution::Skewed, KeyDistribution::Stride};
+    const double read_ratios[] = {0.5, 0.9, 0.99};
+
+    for (KeyDistribution distribution : distributions) {
+        for (double read_ratio : read_ratios) {
+            for (std::size_t threads : settings.ThreadCounts()) {
+                Set set(kStripes);
+                Random filler(7);
+                for (std::size_t i = 0; i < kKeyRange / 2; i++)
+                    set.Insert(NextKey(filler, distribution));
+
+                const std::size_t ops = settings.Scale(1000000);
+                const double seconds = RunThreads(threads, [&](const std::size_t index){
+                    Random random(index + 1);
+                    for (std::size_t i = 0; i < ops / threads; i++) {
+                        const int key = NextKey(random, distribution);
+                        if (random.Uniform() < read_ratio)
+                            set.Contains(key);
+                        else if (random.Next() & 1)
+                            set.Insert(key);
+                        else
+                            set.Remove(key);
+                    }
+                });
+
+                Result(benchmark).Field("buckets", buckets_name).Field("keys", DistributionName(distribution))
+                    .Field("read_ratio", read_ratio).Field("threads", static_cast<double>(threads))
+                    .Rate(ops / threads * threads, seconds);
+            }
+        }
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// ArenaAllocator: 64-byte allocations per second, shared bump pointer
+// and per-thread slabs, against malloc; then ObjectPool New/Delete
+// churn against malloc/free.
+
+struct Object64 {
+    char bytes[64];
+};
+
+static constexpr std::size_t kChurnWindow = 64;
+
+static void BenchmarkAllocators(const Settings& settings) {
+    const std::size_t allocations = settings.Scale(4000000);
+
+    for (std::size_t threads : settings.ThreadCounts()) {
+        const std::size_t per_thread = allocations / threads;
+
+        for (const std::size_t slab_size : {std::size_t(0), ArenaAllocator::kDefaultSlabSize}) {
+            ArenaAllocator arena(64 * 1024 * 1024, /*growable=*/true, slab_size);
+            const double seconds = RunThreads(threads, [&](const std::size_t){
+                for (std::size_t i = 0; i < per_thread; i++)
+                    static_cast<Object64*>(arena.Allocate<Object64>())->bytes[0] = 1;
+            });
+            Result("allocator").Field("allocator", slab_size ? "arena_slab" : "arena_shared")
+                .Field("threads", static_cast<double>(threads)).Rate(per_thread * threads, seconds);
+        }
+
+        // Freed after the clock stops, like the arena, which frees nothing.
+        std::vector<std::vector<void*>> blocks(threads, std::vector<void*>(per_thread));
+        const double seconds = RunThreads(threads, [&](const std::size_t index){
+            for (std::size_t i = 0; i < per_thread; i++) {
+                blocks[index][i] = std::malloc(sizeof(Object64));
+                static_cast<Object64*>(blocks[index][i])->bytes[0] = 1;
+            }
+        });
+        for (auto& part : blocks)
+            for (void* block : part)
+                std::free(block);
+        Result("allocator").Field("allocator", "malloc").Field("threads", static_cast<double>(threads))
+            .Rate(per_thread * threads, seconds);
+
+        // Churn: every thread keeps allocating a window of blocks and
+        // freeing it again, the pattern ObjectPool is there for.
+        ObjectPool<Object64> pool;
+        const double pool_seconds = RunThreads(threads, [&](const std::size_t){
+            Object64* window[kChurnWindow];
+            for (std::size_t i = 0; i < per_thread; i += kChurnWindow) {
+                for (auto& object : window)
+                    (object = pool.New())->bytes[0] = 1;
+                for (auto* object : window)
+                    pool.Delete(object);
+            }
+        });
+        Result("allocator_churn").Field("allocator", "object_pool").Field("threads", static_cast<double>(threads))
+            .Rate(per_thread * threads, pool_seconds);
+
+        const double malloc_seconds = RunThreads(threads, [&](const std::size_t){
+            void* window[kChurnWindow];
+            for (std::size_t i = 0; i < per_thread; i += kChurnWindow) {
+                for (auto& block : window)
+                    static_cast<Object64*>(block = std::malloc(sizeof(Object64)))->bytes[0] = 1;
+                for (void* block : window)
+                    std::free(block);
+            }
+        });
+        Result("allocator_churn").Field("allocator", "malloc").Field("threads", static_cast<double>(threads))
+            .Rate(per_thread * threads, malloc_seconds);
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--quick"))
+            settings.quick = true;
+        else if (!std::strncmp(argv[i], "--filter=", 9))
+            settings.filter = argv[i] + 9;
+        else if (!std::strncmp(argv[i], "--threads=", 10))
+            settings.max_threads = std::max(std::atoi(argv[i] + 10), 1);
+        else {
+            std::fprintf(stderr, "usage: %s [--quick] [--filter=<substring>] [--threads=<max>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    BenchmarkQueues(settings);
+    BenchmarkThreadPool(settings, SchedulingMode::SharedQueue, "shared_queue");
+    BenchmarkThreadPool(settings, SchedulingMode::WorkStealing, "work_stealing");
+    if (settings.Selected("thread_pool_tracing"))
+        BenchmarkTracing(settings);
+    if (settings.Selected("striped_hash_set")) {
+        BenchmarkHashSet<StripedHashSet<int, std::hash<int>, ChainedBuckets>>(settings, "striped_hash_set", "chained");
+        BenchmarkHashSet<StripedHashSet<int, std::hash<int>, PooledChainedBuckets>>(settings, "striped_hash_set", "pooled_chained");
+        BenchmarkHashSet<StripedHashSet<int, std::hash<int>, OpenAddressingBuckets>>(settings, "striped_hash_set", "open_addressing");
+    }
+    if (settings.Selected("split_ordered_hash_set"))
+        BenchmarkHashSet<SplitOrderedHashSet<int>>(settings, "split_ordered_hash_set", "split_ordered");
+    if (settings.Selected("allocator"))
+        BenchmarkAllocators(settings);
+    return 0;
+}
@@ -10,55 +10,440 @@
 #define BlockingQueue_h
 
 #include <atomic>
+#include <cstddef>
 #include <condition_variable>
 #include <stdexcept>
 #include <iostream>
 #include <mutex>
 #include <queue>
+#include <thread>
 #include <utility>
 
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+#include "../Cache Line/CacheLine.h"
+#include "../Spin Wait/SpinWait.h"
+#include "../Stats/Stats.h"
+#include "SPSCQueue.h"
+
+// With C++20 coroutines, AsyncGet/AsyncPut are Get/Put for a coroutine:
+// instead of blocking the thread they suspend the caller, which is
+// resumed by the Put/Get (or Shutdown) that lets it through, in that
+// thread and right after the lock is released. Suspended callers are
+// served before threads blocked in Get/Put; co_await pool.Schedule()
+// moves a resumed coroutine back onto a pool.
+//
+// Container needs push_back/front/pop_front/size. A std::list with
+// PoolAllocator (object_pool.h) takes the node allocated per element
+// from a per-thread free list instead of malloc.
 template <class T, class Container = std::deque<T>>
 class BlockingQueue {
 public:
     
-    explicit BlockingQueue(const size_t& capacity): capacity(capacity), off(false) {}
+    explicit BlockingQueue(const size_t& capacity): off(false), capacity(capacity) {}
     
     void Put(T&& element) {
         std::unique_lock<std::mutex> lock(mutex);
         
-        producer_cv.wait(lock, [this](){return box.size()!=capacity || off; });
+        WaitForSpace(lock);
         if (off)
             throw std::bad_exception();
-        box.push_back(std::move(element));
-        consumer_cv.notify_one();
+        AsyncWaiter* consumer = Deliver(std::move(element));
+        lock.unlock();
+        ResumeAll(consumer);
+    }
+    
+    // Never blocks: returns false, leaving element untouched, if the queue
+    // is full.
+    bool TryPut(T&& element) {
+        std::unique_lock<std::mutex> lock(mutex);
+        
+        if (off)
+            throw std::bad_exception();
+        if (box.size() == capacity)
+            return false;
+        AsyncWaiter* consumer = Deliver(std::move(element));
+        lock.unlock();
+        ResumeAll(consumer);
+        return true;
     }
     
     bool Get(T& result) {
         std::unique_lock<std::mutex> lock(mutex);
-        consumer_cv.wait(lock, [this](){return box.size() || off; });
+        WaitForElements(lock);
         if (off && !box.size())
-        return false;
-        result = std::move(box.front());
-        box.pop_front();
-        producer_cv.notify_one();
+            return false;
+        AsyncWaiter* producer = Take(result);
+        lock.unlock();
+        ResumeAll(producer);
         return true;
     }
     
+    // Never blocks: returns false if the queue is empty right now.
+    bool TryGet(T& result) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!box.size())
+            return false;
+        
+        AsyncWaiter* producer = Take(result);
+        lock.unlock();
+        ResumeAll(producer);
+        return true;
+    }
+    
+    // Moves [first, last) into the queue, taking the lock once per run of
+    // free slots instead of once per element. If the queue is shut down
+    // half way, std::bad_exception is thrown and the rest stays in the range.
+    template <class InputIt>
+    void PutBatch(InputIt first, InputIt last) {
+        std::unique_lock<std::mutex> lock(mutex);
+        
+        while (first != last) {
+            WaitForSpace(lock);
+            if (off)
+                throw std::bad_exception();
+            
+            AsyncWaiters consumers;
+            std::size_t moved = 0;
+            for (; first != last && box.size() != capacity; ++first) {
+                if (AsyncWaiter* consumer = async_consumers.Pop()) {
+                    Hand(consumer, std::move(*first));
+                    consumers.Push(consumer);
+                } else {
+                    box.push_back(std::move(*first));
+                    moved++;
+                }
+            }
+            
+            WakeConsumers(moved);
+            if (consumers.head) {
+                lock.unlock();
+                ResumeAll(consumers.Detach());
+                lock.lock();
+            }
+        }
+    }
+    
+    // Waits for at least one element, then drains up to max_items of
+    // whatever is available into out. Returns 0 once shut down and empty.
+    template <class OutputIt>
+    std::size_t GetBatch(OutputIt out, const std::size_t max_items) {
+        std::unique_lock<std::mutex> lock(mutex);
+        
+        WaitForElements(lock);
+        
+        std::size_t moved = 0;
+        for (; moved < max_items && box.size(); ++moved) {
+            *out++ = std::move(box.front());
+            box.pop_front();
+        }
+        
+        AsyncWaiters producers;
+        std::size_t refilled = 0;
+        for (; refilled < moved; ++refilled) {
+            AsyncWaiter* producer = async_producers.Pop();
+            if (!producer)
+                break;
+            box.push_back(std::move(*producer->element));
+            producer->done = true;
+            producers.Push(producer);
+        }
+        
+        WakeProducers(moved - refilled);
+        lock.unlock();
+        ResumeAll(producers.Detach());
+        return moved;
+    }
+    
+    BlockingQueueStats GetStats() const {
+        BlockingQueueStats result;
+        result.put_blocks = put_blocks.Load();
+        result.put_blocked_ns = put_blocked_ns.Load();
+        result.get_blocks = get_blocks.Load();
+        result.get_blocked_ns = get_blocked_ns.Load();
+        return result;
+    }
+    
     void Shutdown() {
+        std::unique_lock<std::mutex> lock(mutex);
         off.store(true);
         consumer_cv.notify_all();
         producer_cv.notify_all();
+        AsyncWaiter* consumers = async_consumers.Detach();
+        AsyncWaiter* producers = async_producers.Detach();
+        lock.unlock();
+        ResumeAll(consumers);
+        ResumeAll(producers);
     }
     
-    private:
-    std::size_t capacity;
-    std::atomic_bool off;
+#if defined(__cpp_impl_coroutine)
+    class GetAwaiter;
+    class PutAwaiter;
+    
+    // co_await AsyncGet(result) yields what Get(result) returns.
+    GetAwaiter AsyncGet(T& result) {
+        return GetAwaiter(*this, result);
+    }
+    
+    // co_await AsyncPut(element) throws std::bad_exception, leaving
+    // element untouched, once the queue is shut down, like Put.
+    PutAwaiter AsyncPut(T&& element) {
+        return PutAwaiter(*this, element);
+    }
+#endif
+    
+private:
+    // A coroutine suspended in AsyncGet/AsyncPut. It lives in the
+    // coroutine's frame and is linked into a FIFO under the lock; whoever
+    // takes it out fills in done and resumes it once the lock is released.
+    struct AsyncWaiter {
+        T* element = nullptr;
+        bool done = false;
+        void* frame = nullptr;
+        AsyncWaiter* next = nullptr;
+    };
+    
+    struct AsyncWaiters {
+        AsyncWaiter* head = nullptr;
+        AsyncWaiter* tail = nullptr;
+        
+        void Push(AsyncWaiter* waiter) {
+            waiter->next = nullptr;
+            if (tail)
+                tail->next = waiter;
+            else
+                head = waiter;
+            tail = waiter;
+        }
+        
+        AsyncWaiter* Pop() {
+            AsyncWaiter* waiter = head;
+            if (waiter) {
+                head = waiter->next;
+                if (!head)
+                    tail = nullptr;
+                waiter->next = nullptr;
+            }
+            return waiter;
+        }
+        
+        AsyncWaiter* Detach() {
+            AsyncWaiter* waiters = head;
+            head = tail = nullptr;
+            return waiters;
+        }
+    };
     
+    // A resumed coroutine may finish and free its waiter before returning
+    // here, so the link is read first.
+    static void ResumeAll(AsyncWaiter* waiter) {
+        while (waiter) {
+            AsyncWaiter* next = waiter->next;
+#if defined(__cpp_impl_coroutine)
+            std::coroutine_handle<>::from_address(waiter->frame).resume();
+#endif
+            waiter = next;
+        }
+    }
+    
+    static void Hand(AsyncWaiter* consumer, T&& element) {
+        *consumer->element = std::move(element);
+        consumer->done = true;
+    }
+    
+    // Consumers only suspend on an empty queue, so one waiting means the
+    // element can skip the box. Returns the consumer to resume, if any.
+    AsyncWaiter* Deliver(T&& element) {
+        AsyncWaiter* consumer = async_consumers.Pop();
+        if (consumer) {
+            Hand(consumer, std::move(element));
+            return consumer;
+        }
+        box.push_back(std::move(element));
+        WakeConsumers(1);
+        return nullptr;
+    }
+    
+    // Producers only suspend on a full queue, so the slot just freed goes
+    // to the oldest of them. Returns the producer to resume, if any.
+    AsyncWaiter* Take(T& result) {
+        result = std::move(box.front());
+        box.pop_front();
+        AsyncWaiter* producer = async_producers.Pop();
+        if (producer) {
+            box.push_back(std::move(*producer->element));
+            producer->done = true;
+            return producer;
+        }
+        WakeProducers(1);
+        return nullptr;
+    }
+    
+    // An empty queue is first watched through the lock-free size mirror,
+    // spinning and then yielding, and only then waited on, so a consumer
+    // that is about to get an element does not go through the futex. Only
+    // the wait counts as blocking in the stats.
+    void WaitForElements(std::unique_lock<std::mutex>& lock) {
+        if (box.size() || off)
+            return;
+        
+        lock.unlock();
+        SpinWait::Until([this](){ return size.load(std::memory_order_relaxed) || off; });
+        lock.lock();
+        if (box.size() || off)
+            return;
+        
+        get_blocks.Add();
+        const std::uint64_t blocked_since = StatsNow();
+        consumers_waiting++;
+        consumer_cv.wait(lock, [this](){return box.size() || off; });
+        consumers_waiting--;
+        get_blocked_ns.Add(StatsNow() - blocked_since);
+    }
+    
+    void WaitForSpace(std::unique_lock<std::mutex>& lock) {
+        if (box.size() != capacity || off)
+            return;
+        put_blocks.Add();
+        const std::uint64_t blocked_since = StatsNow();
+        
+        producers_waiting++;
+        producer_cv.wait(lock, [this](){return box.size()!=capacity || off; });
+        producers_waiting--;
+        put_blocked_ns.Add(StatsNow() - blocked_since);
+    }
+    
+    // Both run under the lock, which makes the waiter counts exact: a
+    // notify is only issued when somebody is actually asleep.
+    void WakeConsumers(const std::size_t added) {
+        size.store(box.size(), std::memory_order_relaxed);
+        if (!consumers_waiting || !added)
+            return;
+        if (added == 1)
+            consumer_cv.notify_one();
+        else
+            consumer_cv.notify_all();
+    }
+    
+    void WakeProducers(const std::size_t removed) {
+        size.store(box.size(), std::memory_order_relaxed);
+        if (!producers_waiting || !removed)
+            return;
+        if (removed == 1)
+            producer_cv.notify_one();
+        else
+            producer_cv.notify_all();
+    }
+    
+    // One line each for the lock word, which changes hands all the time,
+    // the flags spinning consumers poll without it, the state only the
+    // lock holder touches, and the condition variables.
+    alignas(kCacheLineSize) std::mutex mutex;
+    
+    alignas(kCacheLineSize) std::atomic_bool off;
+    std::atomic<std::size_t> size{0};
+    
+    alignas(kCacheLineSize) std::size_t capacity;
     Container box;
+    std::size_t consumers_waiting = 0;
+    std::size_t producers_waiting = 0;
+    AsyncWaiters async_consumers;
+    AsyncWaiters async_producers;
     
-    std::mutex mutex;
-    std::condition_variable producer_cv;
+    alignas(kCacheLineSize) std::condition_variable producer_cv;
     std::condition_variable consumer_cv;
+    
+    ShardedCounter put_blocks;
+    ShardedCounter put_blocked_ns;
+    ShardedCounter get_blocks;
+    ShardedCounter get_blocked_ns;
+    
+#if defined(__cpp_impl_coroutine)
+public:
+    class GetAwaiter {
+    public:
+        GetAwaiter(BlockingQueue& queue, T& result): queue(queue) {
+            waiter.element = &result;
+        }
+        
+        bool await_ready() const noexcept {
+            return false;
+        }
+        
+        // Takes an element right away when there is one; otherwise the
+        // coroutine stays suspended, and may already be running elsewhere
+        // once the lock is released, so nothing here touches *this after.
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            if (queue.box.size()) {
+                AsyncWaiter* producer = queue.Take(*waiter.element);
+                waiter.done = true;
+                lock.unlock();
+                ResumeAll(producer);
+                return false;
+            }
+            if (queue.off)
+                return false;
+            waiter.frame = handle.address();
+            queue.async_consumers.Push(&waiter);
+            return true;
+        }
+        
+        bool await_resume() const noexcept {
+            return waiter.done;
+        }
+        
+    private:
+        BlockingQueue& queue;
+        AsyncWaiter waiter;
+    };
+    
+    class PutAwaiter {
+    public:
+        PutAwaiter(BlockingQueue& queue, T& element): queue(queue) {
+            waiter.element = &element;
+        }
+        
+        bool await_ready() const noexcept {
+            return false;
+        }
+        
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            if (queue.off)
+                return false;
+            if (queue.box.size() != queue.capacity) {
+                AsyncWaiter* consumer = queue.Deliver(std::move(*waiter.element));
+                waiter.done = true;
+                lock.unlock();
+                ResumeAll(consumer);
+                return false;
+            }
+            waiter.frame = handle.address();
+            queue.async_producers.Push(&waiter);
+            return true;
+        }
+        
+        void await_resume() const {
+            if (!waiter.done)
+                throw std::bad_exception();
+        }
+        
+    private:
+        BlockingQueue& queue;
+        AsyncWaiter waiter;
+    };
+#endif
+};
+
+// BlockingQueue<T, SingleProducerSingleConsumer<wait>> is the SPSC ring
+// of SPSCQueue.h, for pipelines with exactly one thread on either end.
+template <class T, SPSCWait wait>
+class BlockingQueue<T, SingleProducerSingleConsumer<wait>>: public SPSCQueue<T, wait> {
+public:
+    using SPSCQueue<T, wait>::SPSCQueue;
 };
 
 #endif /* BlockingQueue_h */
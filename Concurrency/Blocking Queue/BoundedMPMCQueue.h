@@ -0,0 +1,216 @@
+//
+//  BoundedMPMCQueue.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef BoundedMPMCQueue_h
+#define BoundedMPMCQueue_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "../Cache Line/CacheLine.h"
+#include "../Spin Wait/SpinWait.h"
+
+// Fixed-capacity lock-free queue in the spirit of D. Vyukov's bounded
+// MPMC queue: every cell carries a sequence number telling producers and
+// consumers whose turn it is, so a Put or Get that does not wait writes
+// only its own position counter (one CAS) and its cell. It also reads
+// the other side's waiting count, which lives on its own line and is
+// written only by callers that park. Storage is one array allocated up
+// front; capacity is rounded up to a power of two.
+//
+// Put/Get/Shutdown behave like BlockingQueue: Put throws std::bad_exception
+// once the queue is shut down, Get returns false once it is shut down and
+// drained. Shutdown sets a bit in the tail counter, so a producer either
+// claims its cell before it or fails its CAS. Blocking callers spin for a
+// while (see SpinWait.h) and only then park.
+template <class T>
+class BoundedMPMCQueue {
+public:
+
+    explicit BoundedMPMCQueue(const size_t& capacity): capacity(round_up(capacity)), mask(this->capacity - 1), cells(new Cell[this->capacity]), producers_waiting(0), consumers_waiting(0) {
+        for (std::size_t i = 0; i < this->capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedMPMCQueue(const BoundedMPMCQueue& other) = delete;
+    BoundedMPMCQueue& operator=(const BoundedMPMCQueue& other) = delete;
+
+    ~BoundedMPMCQueue() {
+        for (std::size_t position = head.load(); position != (tail.load() & ~kClosed); position++)
+            cells[position & mask].element()->~T();
+    }
+
+    // A waiter that wakes to a cell still being emptied by its consumer
+    // (or filled by its producer, in Get) goes back to spinning.
+    void Put(T&& element) {
+        while (!SpinWait::Until([&](){ return Enqueue(element); })) {
+            std::unique_lock<std::mutex> lock(park_mutex);
+            producers_waiting.fetch_add(1);
+            producer_cv.wait(lock, [this](){ return HasSpace() || Closed(); });
+            producers_waiting.fetch_sub(1);
+        }
+    }
+
+    bool TryPut(T&& element) {
+        return Enqueue(element);
+    }
+
+    bool Get(T& result) {
+        bool drained = false;
+        while (!SpinWait::Until([&](){ return Dequeue(result) || (drained = Drained()); })) {
+            std::unique_lock<std::mutex> lock(park_mutex);
+            consumers_waiting.fetch_add(1);
+            consumer_cv.wait(lock, [this](){ return HasClaimed() || Closed(); });
+            consumers_waiting.fetch_sub(1);
+        }
+        return !drained;
+    }
+
+    bool TryGet(T& result) {
+        return Dequeue(result);
+    }
+
+    void Shutdown() {
+        tail.fetch_or(kClosed);
+        std::lock_guard<std::mutex> lock(park_mutex);
+        consumer_cv.notify_all();
+        producer_cv.notify_all();
+    }
+
+private:
+
+    static constexpr std::size_t kClosed = ~(std::numeric_limits<std::size_t>::max() >> 1);
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        T* element() {
+            return reinterpret_cast<T*>(&storage);
+        }
+    };
+
+    static std::size_t round_up(std::size_t capacity) {
+        if (capacity > std::numeric_limits<std::size_t>::max() / 4)
+            throw std::length_error("BoundedMPMCQueue cannot be unbounded");
+        std::size_t result = 2;
+        while (result < capacity)
+            result <<= 1;
+        return result;
+    }
+
+    // false if the queue is full; throws once it is shut down.
+    bool Enqueue(T& element) {
+        std::size_t position = tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            if (position & kClosed)
+                throw std::bad_exception();
+            cell = &cells[position & mask];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (cell->element()) T(std::move(element));
+        cell->sequence.store(position + 1, std::memory_order_release);
+
+        // The seq_cst CAS above and the seq_cst increment in Get order
+        // this load against the waiter's look at tail: either it sees the
+        // waiter, or the waiter sees the claimed cell and does not park.
+        if (consumers_waiting.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(park_mutex);
+            consumer_cv.notify_one();
+        }
+        return true;
+    }
+
+    bool Dequeue(T& result) {
+        std::size_t position = head.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[position & mask];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+
+        result = std::move(*cell->element());
+        cell->element()->~T();
+        cell->sequence.store(position + capacity, std::memory_order_release);
+
+        if (producers_waiting.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(park_mutex);
+            producer_cv.notify_one();
+        }
+        return true;
+    }
+
+    // Waiters look at claimed positions, not at cells: those are what the
+    // seq_cst CASes order against the waiting counts. Head is read first,
+    // so it never passes the tail it is compared with.
+    bool HasClaimed() const {
+        const std::size_t position = head.load();
+        return (tail.load() & ~kClosed) != position;
+    }
+
+    bool HasSpace() const {
+        const std::size_t position = head.load();
+        return (tail.load() & ~kClosed) - position < capacity;
+    }
+
+    bool Closed() const {
+        return tail.load() & kClosed;
+    }
+
+    // Once the tail is closed it never moves again, so a head that has
+    // caught up with it means every claimed cell has been taken.
+    bool Drained() const {
+        const std::size_t position = tail.load();
+        return (position & kClosed) && head.load() == (position & ~kClosed);
+    }
+
+    const std::size_t capacity;
+    const std::size_t mask;
+    std::unique_ptr<Cell[]> cells;
+
+    // Each side writes its own position; the waiting counts are written
+    // only by parking callers and read by every operation of the other
+    // side, so none of them shares a line.
+    alignas(kCacheLineSize) std::atomic<size_t> tail{0};
+    alignas(kCacheLineSize) std::atomic<size_t> head{0};
+    alignas(kCacheLineSize) std::atomic<size_t> producers_waiting;
+    alignas(kCacheLineSize) std::atomic<size_t> consumers_waiting;
+
+    alignas(kCacheLineSize) std::mutex park_mutex;
+    std::condition_variable producer_cv;
+    std::condition_variable consumer_cv;
+};
+
+#endif /* BoundedMPMCQueue_h */
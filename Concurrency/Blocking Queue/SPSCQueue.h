@@ -0,0 +1,294 @@
+//
+//  SPSCQueue.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef SPSCQueue_h
+#define SPSCQueue_h
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "../Cache Line/CacheLine.h"
+#include "../Spin Wait/SpinWait.h"
+#include "../Stats/Stats.h"
+
+// How an SPSCQueue side waits for the other. Park spins, yields and then
+// sleeps on a condition variable, which costs every operation a fence to
+// see whether the other side is asleep; Spin never sleeps and so never
+// needs one, for stages that own a core.
+enum class SPSCWait {
+    Park,
+    Spin
+};
+
+// Tag for BlockingQueue's second parameter: BlockingQueue<T,
+// SingleProducerSingleConsumer<>> is the SPSCQueue below.
+template <SPSCWait wait = SPSCWait::Park>
+struct SingleProducerSingleConsumer {};
+
+// Ring buffer for exactly one producer thread and one consumer thread.
+// Each side owns its index and keeps a cached copy of the other's, which
+// it only reloads when the ring looks full (producer) or empty (consumer),
+// so TryPut and TryGet are wait-free and usually touch no cache line the
+// other side is writing. Capacity is rounded up to a power of two.
+//
+// Put/Get/Shutdown behave like BlockingQueue: Put throws
+// std::bad_exception once the queue is shut down, Get returns false once
+// it is shut down and drained. Blocking callers wait as SPSCWait says; a
+// parked side is only notified if its flag is up. PutBatch/GetBatch
+// publish a whole run with one index store (and one fence).
+template <class T, SPSCWait wait = SPSCWait::Park>
+class SPSCQueue {
+public:
+
+    explicit SPSCQueue(const size_t& capacity): capacity(round_up(capacity)), mask(this->capacity - 1), slots(new Slot[this->capacity]), off(false) {}
+
+    SPSCQueue(const SPSCQueue& other) = delete;
+    SPSCQueue& operator=(const SPSCQueue& other) = delete;
+
+    ~SPSCQueue() {
+        for (std::size_t position = head.load(); position != tail.load(); position++)
+            slots[position & mask].element()->~T();
+    }
+
+    void Put(T&& element) {
+        T* first = &element;
+        for (std::size_t spin = 0; !Enqueue(first, first + 1); spin++)
+            WaitForSpace(spin);
+    }
+
+    // Never blocks: returns false, leaving element untouched, if the queue
+    // is full.
+    bool TryPut(T&& element) {
+        T* first = &element;
+        return Enqueue(first, first + 1) != 0;
+    }
+
+    bool Get(T& result) {
+        T* out = &result;
+        return WaitForElements() && Dequeue(out, 1);
+    }
+
+    // Never blocks: returns false if the queue is empty right now.
+    bool TryGet(T& result) {
+        T* out = &result;
+        return Dequeue(out, 1) != 0;
+    }
+
+    // Moves [first, last) into the queue, one publication per run of free
+    // slots. If the queue is shut down half way, std::bad_exception is
+    // thrown and the rest stays in the range.
+    template <class InputIt>
+    void PutBatch(InputIt first, InputIt last) {
+        for (std::size_t spin = 0; first != last; ) {
+            if (Enqueue(first, last))
+                spin = 0;
+            else
+                WaitForSpace(spin++);
+        }
+    }
+
+    // Waits for at least one element, then drains up to max_items of
+    // whatever is available into out. Returns 0 once shut down and empty.
+    template <class OutputIt>
+    std::size_t GetBatch(OutputIt out, const std::size_t max_items) {
+        if (!max_items || !WaitForElements())
+            return 0;
+        return Dequeue(out, max_items);
+    }
+
+    BlockingQueueStats GetStats() const {
+        BlockingQueueStats result;
+        result.put_blocks = put_blocks.Load();
+        result.put_blocked_ns = put_blocked_ns.Load();
+        result.get_blocks = get_blocks.Load();
+        result.get_blocked_ns = get_blocked_ns.Load();
+        return result;
+    }
+
+    void Shutdown() {
+        off.store(true);
+        if (wait == SPSCWait::Spin)
+            return;
+        std::lock_guard<std::mutex> lock(park_mutex);
+        consumer_cv.notify_all();
+        producer_cv.notify_all();
+    }
+
+private:
+
+    struct Slot {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        T* element() {
+            return reinterpret_cast<T*>(&storage);
+        }
+    };
+
+    static std::size_t round_up(std::size_t capacity) {
+        if (capacity > std::numeric_limits<std::size_t>::max() / 2 + 1)
+            throw std::length_error("SPSCQueue cannot be unbounded");
+        std::size_t result = 2;
+        while (result < capacity)
+            result <<= 1;
+        return result;
+    }
+
+    // Producer side. Moves elements from first while there is room and
+    // returns how many. off is checked before anything is taken, so a
+    // shut down queue never swallows an element.
+    template <class InputIt>
+    std::size_t Enqueue(InputIt& first, const InputIt last) {
+        if (off.load(std::memory_order_acquire))
+            throw std::bad_exception();
+        const std::size_t position = tail.load(std::memory_order_relaxed);
+        if (position - cached_head == capacity) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (position - cached_head == capacity)
+                return 0;
+        }
+
+        const std::size_t room = capacity - (position - cached_head);
+        std::size_t moved = 0;
+        for (; first != last && moved < room; ++first, ++moved)
+            new (slots[(position + moved) & mask].element()) T(std::move(*first));
+
+        tail.store(position + moved, std::memory_order_release);
+        Wake(consumer_waiting, consumer_cv);
+        return moved;
+    }
+
+    // Consumer side. Moves up to max_items into out and returns how many.
+    template <class OutputIt>
+    std::size_t Dequeue(OutputIt& out, const std::size_t max_items) {
+        const std::size_t position = head.load(std::memory_order_relaxed);
+        if (cached_tail == position) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (cached_tail == position)
+                return 0;
+        }
+
+        const std::size_t moved = std::min(cached_tail - position, max_items);
+        for (std::size_t i = 0; i < moved; i++) {
+            T* element = slots[(position + i) & mask].element();
+            *out++ = std::move(*element);
+            element->~T();
+        }
+
+        head.store(position + moved, std::memory_order_release);
+        Wake(producer_waiting, producer_cv);
+        return moved;
+    }
+
+    // Returns false once the queue is shut down and drained. off is read
+    // before the last look at tail: the producer's final elements are
+    // published before it (or anybody after it) shuts the queue down.
+    bool WaitForElements() {
+        for (std::size_t spin = 0; !HasElements(); spin++) {
+            if (off.load())
+                return HasElements();
+            if (Backoff(spin)) {
+                get_blocks.Add();
+                const std::uint64_t blocked_since = StatsNow();
+                Park(consumer_waiting, consumer_cv, [this](){ return HasElements() || off.load(); });
+                get_blocked_ns.Add(StatsNow() - blocked_since);
+            }
+        }
+        return true;
+    }
+
+    void WaitForSpace(const std::size_t spin) {
+        if (Backoff(spin)) {
+            put_blocks.Add();
+            const std::uint64_t blocked_since = StatsNow();
+            Park(producer_waiting, producer_cv, [this](){ return HasSpace() || off.load(); });
+            put_blocked_ns.Add(StatsNow() - blocked_since);
+        }
+    }
+
+    // Spins, then yields, as SpinWait does; returns true once it is time
+    // to park instead. SPSCWait::Spin keeps yielding.
+    static bool Backoff(const std::size_t spin) {
+        if (spin < SpinWait::kSpinCount)
+            cpu_relax();
+        else if (wait == SPSCWait::Spin || spin < SpinWait::kSpinCount + SpinWait::kYieldCount)
+            std::this_thread::yield();
+        else
+            return true;
+        return false;
+    }
+
+    bool HasElements() {
+        if (cached_tail != head.load(std::memory_order_relaxed))
+            return true;
+        cached_tail = tail.load(std::memory_order_acquire);
+        return cached_tail != head.load(std::memory_order_relaxed);
+    }
+
+    bool HasSpace() const {
+        return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) != capacity;
+    }
+
+    // The sleeper raises its flag and then checks the ring, the other side
+    // publishes and then checks the flag; the fences on both sides make
+    // sure at least one of them sees the other.
+    template <class Ready>
+    void Park(std::atomic<bool>& waiting, std::condition_variable& cv, Ready ready) {
+        std::unique_lock<std::mutex> lock(park_mutex);
+        waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(lock, ready);
+        waiting.store(false, std::memory_order_relaxed);
+    }
+
+    void Wake(std::atomic<bool>& waiting, std::condition_variable& cv) {
+        if (wait == SPSCWait::Spin)
+            return;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!waiting.load(std::memory_order_relaxed))
+            return;
+        std::lock_guard<std::mutex> lock(park_mutex);
+        cv.notify_one();
+    }
+
+    const std::size_t capacity;
+    const std::size_t mask;
+    std::unique_ptr<Slot[]> slots;
+
+    // The producer's line and the consumer's line: each index next to the
+    // cached copy of the other one and the other side's parked flag, which
+    // is read after every operation but only written around a park.
+    alignas(kCacheLineSize) std::atomic<size_t> tail{0};
+    std::size_t cached_head = 0;
+    std::atomic<bool> consumer_waiting{false};
+
+    alignas(kCacheLineSize) std::atomic<size_t> head{0};
+    std::size_t cached_tail = 0;
+    std::atomic<bool> producer_waiting{false};
+
+    alignas(kCacheLineSize) std::atomic_bool off;
+    std::mutex park_mutex;
+    std::condition_variable producer_cv;
+    std::condition_variable consumer_cv;
+
+    ShardedCounter put_blocks;
+    ShardedCounter put_blocked_ns;
+    ShardedCounter get_blocks;
+    ShardedCounter get_blocked_ns;
+};
+
+#endif /* SPSCQueue_h */
@@ -0,0 +1,33 @@
+//
+//  CacheLine.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef CacheLine_h
+#define CacheLine_h
+
+#include <cstddef>
+#include <new>
+
+// Distance that keeps two objects from sharing a cache line: whatever
+// the standard library reports for the target, 64 where it reports
+// nothing. Everything here is header-only and built in one go, so the
+// value moving between compiler versions (GCC warns about that) cannot
+// split a layout across translation units.
+#if defined(__cpp_lib_hardware_interference_size)
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+constexpr std::size_t kCacheLineSize = std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic pop
+#endif
+#else
+constexpr std::size_t kCacheLineSize = 64;
+#endif
+
+#endif /* CacheLine_h */
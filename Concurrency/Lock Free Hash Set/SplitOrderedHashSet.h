@@ -0,0 +1,387 @@
+//
+//  SplitOrderedHashSet.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef SplitOrderedHashSet_h
+#define SplitOrderedHashSet_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "../Cache Line/CacheLine.h"
+#include "../Optimistic Linked List/arena_allocator.h"
+#include "../Optimistic Linked List/epoch_reclamation.h"
+#include "../Striped Hash Set/Buckets.h"
+
+// Lock-free hash set after Shalev & Shavit, "Split-Ordered Lists". All
+// elements live in one lock-free sorted list (Harris/Michael: a node is
+// removed by marking its next pointer, then unlinked by anyone who walks
+// past it), ordered by the bit-reversed hash. Buckets are only shortcuts
+// into that list: bucket b points at a dummy node sitting right where
+// the elements with hash % size == b begin.
+//
+// Growing never moves an element. Doubling the bucket count is a single
+// CAS on size_; bucket b + size then splits b's run of the list in two,
+// and its dummy is linked in by the first operation that needs it,
+// starting from its parent bucket. The bucket directory is a fixed array
+// of segments, each twice the size of the one before, allocated on first
+// use, so it grows without ever being copied either.
+//
+// Insert/Remove are lock-free, Contains is wait-free and, past entering
+// its EpochGuard, writes nothing: a bucket nobody has initialized yet is
+// searched from its nearest initialized ancestor instead. Nodes come from an ArenaAllocator;
+// whichever thread unlinks a removed node retires it, and it goes back
+// into the arena once no operation that could still be walking it is
+// left (see epoch_reclamation.h). Dummy nodes are never removed.
+template <typename T, class Hash = std::hash<T>>
+class SplitOrderedHashSet {
+public:
+    // Owns a growable arena with per-thread slabs.
+    explicit SplitOrderedHashSet(const std::size_t initial_buckets = kSegmentSize):
+    owned_arena_(new ArenaAllocator(kArenaChunk, /*growable=*/true, ArenaAllocator::kDefaultSlabSize)),
+    arena_(*owned_arena_) {
+        Init(initial_buckets);
+    }
+
+    explicit SplitOrderedHashSet(ArenaAllocator& arena, const std::size_t initial_buckets = kSegmentSize): arena_(arena) {
+        Init(initial_buckets);
+    }
+
+    SplitOrderedHashSet(const SplitOrderedHashSet& other) = delete;
+    SplitOrderedHashSet& operator=(const SplitOrderedHashSet& other) = delete;
+
+    ~SplitOrderedHashSet() {
+        // Elements still linked are destroyed; the memory goes with the
+        // arena. Retired ones are reclaimed by domain_ right after.
+        for (Node* node = Pointer(head_->next.load()); node; node = Pointer(node->next.load()))
+            if (!node->IsDummy())
+                static_cast<ElementNode*>(node)->element.~T();
+        for (auto& segment : segments_)
+            delete[] segment.load();
+    }
+
+    bool Insert(const T& element) {
+        EpochGuard guard(domain_);
+        const std::size_t hash_value = MixBucketHash(hash_(element));
+        const std::uint64_t key = RegularKey(hash_value);
+        Node* start = Bucket(hash_value);
+
+        ElementNode* node = nullptr;
+        while (true) {
+            const Window window = Find(start, key, &element);
+            if (window.found) {
+                // Never published, so nobody else can be looking at it.
+                if (node) {
+                    node->~ElementNode();
+                    arena_.Recycle(node, sizeof(ElementNode));
+                }
+                return false;
+            }
+
+            // Allocated once, on the first attempt that can succeed.
+            if (!node)
+                node = arena_.New<ElementNode>(key, element);
+            node->next.store(Link(window.curr), std::memory_order_relaxed);
+            std::uintptr_t expected = Link(window.curr);
+            if (window.pred->next.compare_exchange_strong(expected, Link(node), std::memory_order_release, std::memory_order_relaxed))
+                break;
+        }
+
+        const std::size_t count = count_.fetch_add(1, std::memory_order_relaxed) + 1;
+        std::size_t size = size_.load(std::memory_order_relaxed);
+        if (count > size * kMaxLoadFactor && size < kMaxBuckets)
+            size_.compare_exchange_strong(size, size * 2, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool Remove(const T& element) {
+        EpochGuard guard(domain_);
+        const std::size_t hash_value = MixBucketHash(hash_(element));
+        const std::uint64_t key = RegularKey(hash_value);
+        Node* start = Bucket(hash_value);
+
+        while (true) {
+            const Window window = Find(start, key, &element);
+            if (!window.found)
+                return false;
+
+            // Marking curr's next pointer is the linearization point; the
+            // winner of that CAS is the one that removed the element.
+            std::uintptr_t next = window.curr->next.load(std::memory_order_acquire);
+            if (IsMarked(next))
+                continue;
+            if (!window.curr->next.compare_exchange_strong(next, next | kMark, std::memory_order_acq_rel, std::memory_order_relaxed))
+                continue;
+
+            std::uintptr_t expected = Link(window.curr);
+            if (window.pred->next.compare_exchange_strong(expected, next, std::memory_order_release, std::memory_order_relaxed))
+                Retire(window.curr);
+            else
+                Find(start, key, &element);     // unlinks it on the way
+            count_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    bool Contains(const T& element) const {
+        EpochGuard guard(domain_);
+        const std::size_t hash_value = MixBucketHash(hash_(element));
+        const std::uint64_t key = RegularKey(hash_value);
+
+        for (Node* curr = Pointer(InitializedBucket(hash_value)->next.load(std::memory_order_acquire)); curr; ) {
+            const std::uintptr_t next = curr->next.load(std::memory_order_acquire);
+            if (curr->key > key)
+                return false;
+            if (Matches(curr, key, &element))
+                return !IsMarked(next);
+            curr = Pointer(next);
+        }
+        return false;
+    }
+
+    std::size_t Size() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    std::size_t BucketCount() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    static constexpr std::size_t kSegmentSize = 64;     // buckets in segment 0
+    static constexpr std::size_t kNumSegments = 40;
+    static constexpr std::size_t kMaxBuckets = kSegmentSize << (kNumSegments - 2);
+    static constexpr std::size_t kMaxLoadFactor = 2;
+    static constexpr std::size_t kArenaChunk = 1 << 20;
+    static constexpr std::uintptr_t kMark = 1;
+
+    // Split-order keys: a dummy's is its bucket index reversed, which is
+    // even, an element's is its hash with the top bit set, reversed, which
+    // is odd and sorts right after its bucket's dummy.
+    struct Node {
+        explicit Node(const std::uint64_t key): key(key), next(0) {}
+
+        bool IsDummy() const {
+            return !(key & 1);
+        }
+
+        const std::uint64_t key;
+        std::atomic<std::uintptr_t> next;   // Node*, low bit marks this node removed
+    };
+
+    struct ElementNode: Node {
+        ElementNode(const std::uint64_t key, const T& element): Node(key), element(element) {}
+
+        T element;
+    };
+
+    struct Window {
+        Node* pred;
+        Node* curr;     // first node not before the key, or null
+        bool found;
+    };
+
+    void Init(const std::size_t initial_buckets) {
+        std::size_t size = kSegmentSize;
+        while (size < initial_buckets && size < kMaxBuckets)
+            size *= 2;
+        size_.store(size);
+        count_.store(0);
+
+        head_ = arena_.New<Node>(DummyKey(0));
+        Slot(0).store(head_, std::memory_order_relaxed);
+    }
+
+    static Node* Pointer(const std::uintptr_t link) {
+        return reinterpret_cast<Node*>(link & ~kMark);
+    }
+
+    static std::uintptr_t Link(Node* node) {
+        return reinterpret_cast<std::uintptr_t>(node);
+    }
+
+    static bool IsMarked(const std::uintptr_t link) {
+        return link & kMark;
+    }
+
+    static std::uint64_t Reverse(std::uint64_t x) {
+        x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+        x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+        x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+        return (x >> 32) | (x << 32);
+    }
+
+    static std::uint64_t RegularKey(const std::size_t hash_value) {
+        return Reverse(hash_value) | 1;
+    }
+
+    static std::uint64_t DummyKey(const std::size_t bucket) {
+        return Reverse(bucket);
+    }
+
+    // key == curr->key and, for an element, the same element: hashes may
+    // collide, so equal keys are all checked.
+    static bool Matches(const Node* node, const std::uint64_t key, const T* element) {
+        return node->key == key && (!element || static_cast<const ElementNode*>(node)->element == *element);
+    }
+
+    // Michael's search: the window around key (element null for a dummy),
+    // unlinking and retiring marked nodes it passes. Restarts from start
+    // if a CAS shows pred changed under it.
+    Window Find(Node* start, const std::uint64_t key, const T* element) {
+        while (true) {
+            Node* pred = start;
+            Node* curr = Pointer(pred->next.load(std::memory_order_acquire));
+            bool restart = false;
+
+            while (curr) {
+                const std::uintptr_t next = curr->next.load(std::memory_order_acquire);
+                if (IsMarked(next)) {
+                    std::uintptr_t expected = Link(curr);
+                    if (!pred->next.compare_exchange_strong(expected, next & ~kMark, std::memory_order_release, std::memory_order_relaxed)) {
+                        restart = true;
+                        break;
+                    }
+                    Retire(curr);
+                    curr = Pointer(next);
+                    continue;
+                }
+                if (curr->key > key)
+                    break;
+                if (Matches(curr, key, element))
+                    return Window{pred, curr, true};
+                pred = curr;
+                curr = Pointer(next);
+            }
+            if (!restart)
+                return Window{pred, curr, false};
+        }
+    }
+
+    // Only the thread whose CAS unlinked node may call this, once.
+    void Retire(Node* node) {
+        domain_.Retire(static_cast<ElementNode*>(node), arena_);
+    }
+
+    // The dummy node of the bucket hash_value falls into right now.
+    Node* Bucket(const std::size_t hash_value) {
+        const std::size_t bucket = hash_value & (size_.load(std::memory_order_acquire) - 1);
+        Node* dummy = Slot(bucket).load(std::memory_order_acquire);
+        return dummy ? dummy : InitializeBucket(bucket);
+    }
+
+    // The dummy of that bucket or, if it is not linked in yet, of its
+    // closest ancestor that is. Every dummy sorts before the run of its
+    // descendants, so a search may start there; bucket 0 always exists.
+    const Node* InitializedBucket(const std::size_t hash_value) const {
+        std::size_t bucket = hash_value & (size_.load(std::memory_order_acquire) - 1);
+        while (true) {
+            const std::atomic<Node*>* slot = FindSlot(bucket);
+            const Node* dummy = slot ? slot->load(std::memory_order_acquire) : nullptr;
+            if (dummy)
+                return dummy;
+            bucket = ParentBucket(bucket);
+        }
+    }
+
+    // Links bucket's dummy in after its parent's, the bucket it was split
+    // from, initializing that one first if needed. Threads racing here
+    // all end up with the one dummy that made it into the list.
+    Node* InitializeBucket(const std::size_t bucket) {
+        const std::size_t parent = ParentBucket(bucket);
+        Node* start = Slot(parent).load(std::memory_order_acquire);
+        if (!start)
+            start = InitializeBucket(parent);
+
+        const std::uint64_t key = DummyKey(bucket);
+        Node* dummy = nullptr;
+        while (true) {
+            const Window window = Find(start, key, nullptr);
+            if (window.found) {
+                dummy = window.curr;
+                break;
+            }
+            if (!dummy)
+                dummy = arena_.New<Node>(key);
+            dummy->next.store(Link(window.curr), std::memory_order_relaxed);
+            std::uintptr_t expected = Link(window.curr);
+            if (window.pred->next.compare_exchange_strong(expected, Link(dummy), std::memory_order_release, std::memory_order_relaxed))
+                break;
+        }
+
+        Slot(bucket).store(dummy, std::memory_order_release);
+        return dummy;
+    }
+
+    // bucket with its highest set bit cleared.
+    static std::size_t ParentBucket(std::size_t bucket) {
+        std::size_t top = 1;
+        while (top <= bucket / 2)
+            top <<= 1;
+        return bucket & ~top;
+    }
+
+    // Segment 0 holds buckets [0, kSegmentSize), segment s > 0 holds
+    // [kSegmentSize << (s - 1), kSegmentSize << s).
+    static std::size_t SegmentOf(const std::size_t bucket, std::size_t& first, std::size_t& length) {
+        std::size_t segment = 0;
+        first = 0;
+        length = kSegmentSize;
+        if (bucket >= kSegmentSize) {
+            segment = 1;
+            first = kSegmentSize;
+            while (bucket >= first * 2) {
+                first *= 2;
+                segment++;
+            }
+            length = first;
+        }
+        return segment;
+    }
+
+    // bucket's slot, or null if its segment is not allocated yet.
+    const std::atomic<Node*>* FindSlot(const std::size_t bucket) const {
+        std::size_t first, length;
+        const std::atomic<Node*>* slots = segments_[SegmentOf(bucket, first, length)].load(std::memory_order_acquire);
+        return slots ? &slots[bucket - first] : nullptr;
+    }
+
+    // bucket's slot, allocating its segment on first use.
+    std::atomic<Node*>& Slot(const std::size_t bucket) {
+        std::size_t first, length;
+        const std::size_t segment = SegmentOf(bucket, first, length);
+        std::atomic<Node*>* slots = segments_[segment].load(std::memory_order_acquire);
+        if (!slots) {
+            std::atomic<Node*>* fresh = new std::atomic<Node*>[length]();
+            if (segments_[segment].compare_exchange_strong(slots, fresh, std::memory_order_acq_rel))
+                slots = fresh;
+            else
+                delete[] fresh;
+        }
+        return slots[bucket - first];
+    }
+
+    std::unique_ptr<ArenaAllocator> owned_arena_;
+    ArenaAllocator& arena_;
+
+    Node* head_;                                        // bucket 0's dummy
+    std::atomic<std::size_t> size_;                     // buckets in use, a power of two
+    // The one line every Insert/Remove writes; kept off the others.
+    alignas(kCacheLineSize) std::atomic<std::size_t> count_;
+    alignas(kCacheLineSize) std::atomic<std::atomic<Node*>*> segments_[kNumSegments] = {};
+    mutable EpochDomain domain_;                        // after arena_: reclaims into it
+
+    Hash hash_;
+};
+
+#endif /* SplitOrderedHashSet_h */
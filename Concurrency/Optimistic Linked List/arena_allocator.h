@@ -1,29 +1,76 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <thread>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////
 
+// Bump allocator over a chain of chunks. A fixed arena owns a single
+// chunk and throws std::bad_alloc once it is exhausted; a growable one
+// links a new chunk in front of the chain instead. Switching chunks is a
+// single CAS on current_, so allocation stays lock-free.
+//
+// With a non-zero slab_size every thread first carves a slab of that
+// many bytes out of the shared chunk with one atomic, then bump-allocates
+// from it with plain pointer arithmetic. Threads building nodes for the
+// same structure then stop bouncing one offset cache line between them.
+//
+// Objects are never freed one by one: memory comes back all at once in
+// Reset() or in the destructor. Recycle() hands a single block back for
+// reuse instead. Blocks of up to kMaxRecycledSize bytes are carved at the
+// full size of their 16-byte class, so any block of a class fits every
+// request of that class. A recycled block goes on a free list of the
+// calling thread; a list that grows past 2 * kRecycleBatch hands
+// kRecycleBatch blocks to the arena's list for that class with one CAS,
+// and a thread whose list is empty takes the arena's whole list with one
+// exchange before it bumps, as ObjectPool does. Blocks reclaimed on one
+// thread thus go back to whichever threads allocate. A thread that exits
+// returns its lists too.
+// The reclamation domain (see epoch_reclamation.h) feeds removed nodes of
+// the lock-free structures back this way.
 class ArenaAllocator {
 public:
-    explicit ArenaAllocator(const size_t capacity = 4 * 1024 * 1024)
-        : arena_(new unsigned char[capacity])
+    static constexpr size_t kDefaultSlabSize = 64 * 1024;
+
+    explicit ArenaAllocator(const size_t capacity = 4 * 1024 * 1024,
+                            const bool growable = false,
+                            const size_t slab_size = 0)
+        : chunk_capacity_(capacity),
+          growable_(growable),
+          slab_size_(slab_size),
+          id_(NextArenaId()),
+          shared_(std::make_shared<Shared>()),
+          current_(NewChunk(capacity, nullptr))
     {}
 
     ArenaAllocator(const ArenaAllocator& /* that */) = delete;
     ArenaAllocator(ArenaAllocator&& /* that */) = delete;
 
     ~ArenaAllocator() {
-        delete[] arena_;
+        {
+            std::lock_guard<std::mutex> lock(shared_->mutex_);
+            shared_->alive_ = false;
+        }
+        DeleteChain(current_.load());
     }
 
     template <typename TObject>
     void* Allocate(const size_t alignment = alignof(TObject)) {
-        size_t block_size = sizeof(TObject) + alignment;
-        void* addr = arena_ + next_offset_.fetch_add(block_size);
-        return std::align(alignment, sizeof(TObject), addr, block_size);
+        const size_t size = BlockSize(sizeof(TObject));
+        if (void* recycled = Reuse(size, alignment)) {
+            return recycled;
+        }
+        if (slab_size_ != 0) {
+            return AllocateFromSlab(size, alignment);
+        }
+        return AllocateShared(size, alignment);
     }
 
     template <typename TObject, typename... Args>
@@ -33,13 +80,350 @@ public:
         return static_cast<TObject*>(addr);
     }
 
+    // addr must come from Allocate of this arena with the given size, and
+    // nobody may still read it; any thread may recycle it. Blocks too
+    // small or too large for the size classes are dropped; the memory
+    // stays in the arena.
+    void Recycle(void* addr, const size_t size) {
+        if (!Recyclable(size)) {
+            return;
+        }
+        Slab& slab = OwnSlab();
+        const size_t size_class = SizeClass(size);
+        FreeBlock* block = static_cast<FreeBlock*>(addr);
+        block->next_ = slab.free_[size_class];
+        slab.free_[size_class] = block;
+        if (++slab.count_[size_class] >= 2 * kRecycleBatch) {
+            Spill(slab, size_class);
+        }
+    }
+
+    // Drops every chunk except the first one and rewinds it. Must not
+    // race with Allocate, and invalidates everything handed out so far,
+    // thread slabs and free lists included.
+    void Reset() {
+        {
+            std::lock_guard<std::mutex> lock(shared_->mutex_);
+            shared_->generation_ = generation_.fetch_add(1) + 1;
+            for (std::atomic<FreeBlock*>& list : shared_->free_) {
+                list.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+        Chunk* chunk = current_.load();
+        while (chunk->prev_ != nullptr) {
+            Chunk* prev = chunk->prev_;
+            DeleteChunk(chunk);
+            chunk = prev;
+        }
+        chunk->offset_.store(0);
+        current_.store(chunk);
+    }
+
+    // Bytes handed out, alignment slack and whole thread slabs included.
     size_t SpaceUsed() const {
-        return next_offset_.load();
+        size_t used = 0;
+        for (Chunk* chunk = current_.load(); chunk != nullptr; chunk = chunk->prev_) {
+            used += std::min(chunk->offset_.load(), chunk->capacity_);
+        }
+        return used;
+    }
+
+    // Bytes obtained from the system for all chunks.
+    size_t SpaceReserved() const {
+        size_t reserved = 0;
+        for (Chunk* chunk = current_.load(); chunk != nullptr; chunk = chunk->prev_) {
+            reserved += chunk->capacity_;
+        }
+        return reserved;
+    }
+
+private:
+    struct Chunk {
+        Chunk* prev_;
+        const size_t capacity_;
+        std::atomic<size_t> offset_{0};
+
+        Chunk(Chunk* prev, const size_t capacity)
+            : prev_(prev),
+              capacity_(capacity)
+        {}
+
+        unsigned char* Data() {
+            return reinterpret_cast<unsigned char*>(this + 1);
+        }
+    };
+
+    struct FreeBlock {
+        FreeBlock* next_;
+    };
+
+    static constexpr size_t kSizeClassStep = 16;
+    static constexpr size_t kMaxRecycledSize = 256;
+    static constexpr size_t kNumSizeClasses = kMaxRecycledSize / kSizeClassStep;
+    static constexpr size_t kRecycleBatch = 32;
+
+    // What outlives the arena for the sake of threads that still hold
+    // its free lists. generation_ mirrors the arena's under mutex_.
+    struct Shared {
+        std::atomic<FreeBlock*> free_[kNumSizeClasses] = {};
+        std::mutex mutex_;
+        bool alive_{true};
+        uint64_t generation_{0};
+    };
+
+    // Per-thread bump window and free lists for one arena.
+    struct Slab {
+        uint64_t arena_id_{0};
+        uint64_t generation_{0};
+        uintptr_t cursor_{0};
+        uintptr_t end_{0};
+        FreeBlock* free_[kNumSizeClasses] = {};
+        size_t count_[kNumSizeClasses] = {};
+        std::shared_ptr<Shared> shared_;
+    };
+
+    // The calling thread's slabs, one per arena it has used, like
+    // EpochDomain's records. Ids are never reused, so an entry left behind
+    // by a destroyed arena never matches.
+    struct ThreadSlabs {
+        std::vector<std::unique_ptr<Slab>> slabs_;
+
+        ~ThreadSlabs() {
+            for (const auto& slab : slabs_) {
+                Flush(*slab);
+            }
+        }
+    };
+
+    static bool Recyclable(const size_t size) {
+        return size >= sizeof(FreeBlock) && size <= kMaxRecycledSize;
+    }
+
+    static size_t SizeClass(const size_t size) {
+        return (size - 1) / kSizeClassStep;
+    }
+
+    // Recyclable sizes are rounded up to their class.
+    static size_t BlockSize(const size_t size) {
+        return Recyclable(size) ? (SizeClass(size) + 1) * kSizeClassStep : size;
+    }
+
+    // The calling thread's slab, emptied if it belongs to an older
+    // generation; the lists of that generation are gone already.
+    Slab& OwnSlab() {
+        Slab& slab = ThreadSlab();
+        const uint64_t generation = generation_.load(std::memory_order_relaxed);
+        if (slab.generation_ != generation) {
+            slab = Slab();
+            slab.arena_id_ = id_;
+            slab.generation_ = generation;
+            slab.shared_ = shared_;
+        }
+        return slab;
+    }
+
+    // Pops a recycled block of size's class if the head is aligned
+    // enough, refilling the thread's list from the arena's first.
+    void* Reuse(const size_t size, const size_t alignment) {
+        if (!Recyclable(size)) {
+            return nullptr;
+        }
+        const size_t size_class = SizeClass(size);
+        Slab& slab = ThreadSlab();
+        const bool owned = slab.generation_ == generation_.load(std::memory_order_relaxed);
+        if (!owned || slab.free_[size_class] == nullptr) {
+            if (shared_->free_[size_class].load(std::memory_order_relaxed) == nullptr) {
+                return nullptr;
+            }
+            Refill(OwnSlab(), size_class);
+        }
+        FreeBlock*& head = slab.free_[size_class];
+        if (head == nullptr || (reinterpret_cast<uintptr_t>(head) & (alignment - 1)) != 0) {
+            return nullptr;
+        }
+        FreeBlock* block = head;
+        head = block->next_;
+        slab.count_[size_class]--;
+        return block;
+    }
+
+    static void PushChain(Shared& shared, const size_t size_class, FreeBlock* first, FreeBlock* last) {
+        std::atomic<FreeBlock*>& list = shared.free_[size_class];
+        FreeBlock* head = list.load(std::memory_order_relaxed);
+        do {
+            last->next_ = head;
+        } while (!list.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Moves the kRecycleBatch most recently recycled blocks of the class
+    // to the arena's list.
+    void Spill(Slab& slab, const size_t size_class) {
+        FreeBlock* first = slab.free_[size_class];
+        FreeBlock* last = first;
+        for (size_t i = 1; i < kRecycleBatch; i++) {
+            last = last->next_;
+        }
+        slab.free_[size_class] = last->next_;
+        slab.count_[size_class] -= kRecycleBatch;
+        PushChain(*shared_, size_class, first, last);
+    }
+
+    // Taking the whole list at once keeps the arena's lists free of ABA.
+    void Refill(Slab& slab, const size_t size_class) {
+        FreeBlock* taken = shared_->free_[size_class].exchange(nullptr, std::memory_order_acquire);
+        if (taken == nullptr) {
+            return;
+        }
+        FreeBlock* last = taken;
+        size_t count = 1;
+        while (last->next_ != nullptr) {
+            last = last->next_;
+            count++;
+        }
+        last->next_ = slab.free_[size_class];
+        slab.free_[size_class] = taken;
+        slab.count_[size_class] += count;
+    }
+
+    // Hands a slot's lists back to their arena if it still exists and
+    // has not been Reset since.
+    static void Flush(Slab& slab) {
+        if (!slab.shared_) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(slab.shared_->mutex_);
+        if (!slab.shared_->alive_ || slab.shared_->generation_ != slab.generation_) {
+            return;
+        }
+        for (size_t size_class = 0; size_class < kNumSizeClasses; size_class++) {
+            FreeBlock* first = slab.free_[size_class];
+            if (first == nullptr) {
+                continue;
+            }
+            FreeBlock* last = first;
+            while (last->next_ != nullptr) {
+                last = last->next_;
+            }
+            PushChain(*slab.shared_, size_class, first, last);
+            slab.free_[size_class] = nullptr;
+            slab.count_[size_class] = 0;
+        }
+    }
+
+    static uint64_t NextArenaId() {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1);
+    }
+
+    Slab& ThreadSlab() const {
+        static thread_local ThreadSlabs local;
+        for (const auto& slab : local.slabs_) {
+            if (slab->arena_id_ == id_) {
+                return *slab;
+            }
+        }
+
+        // Forget arenas that have been destroyed before adding this one.
+        std::vector<std::unique_ptr<Slab>>& slabs = local.slabs_;
+        for (size_t i = 0; i < slabs.size(); ) {
+            bool alive;
+            {
+                std::lock_guard<std::mutex> lock(slabs[i]->shared_->mutex_);
+                alive = slabs[i]->shared_->alive_;
+            }
+            if (!alive) {
+                slabs[i] = std::move(slabs.back());
+                slabs.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        slabs.push_back(std::make_unique<Slab>());
+        Slab& slab = *slabs.back();
+        slab.arena_id_ = id_;
+        slab.generation_ = generation_.load(std::memory_order_relaxed);
+        slab.shared_ = shared_;
+        return slab;
+    }
+
+    void* AllocateFromSlab(const size_t size, const size_t alignment) {
+        Slab& slab = ThreadSlab();
+        const uint64_t generation = generation_.load(std::memory_order_relaxed);
+        if (slab.generation_ == generation) {
+            uintptr_t addr = (slab.cursor_ + alignment - 1) & ~(alignment - 1);
+            if (addr + size <= slab.end_) {
+                slab.cursor_ = addr + size;
+                return reinterpret_cast<void*>(addr);
+            }
+        }
+
+        // Large objects would waste most of a slab, so they skip it.
+        if (size + alignment > slab_size_ / 4) {
+            return AllocateShared(size, alignment);
+        }
+
+        void* begin = AllocateShared(slab_size_, alignof(std::max_align_t));
+        Slab& own = OwnSlab();
+        own.cursor_ = reinterpret_cast<uintptr_t>(begin);
+        own.end_ = own.cursor_ + slab_size_;
+        return AllocateFromSlab(size, alignment);
+    }
+
+    void* AllocateShared(const size_t size, const size_t alignment) {
+        size_t block_size = size + alignment;
+        while (true) {
+            Chunk* chunk = current_.load(std::memory_order_acquire);
+            size_t offset = chunk->offset_.fetch_add(block_size);
+            if (offset + block_size <= chunk->capacity_) {
+                void* addr = chunk->Data() + offset;
+                return std::align(alignment, size, addr, block_size);
+            }
+            Grow(chunk, block_size);
+        }
+    }
+
+    static Chunk* NewChunk(const size_t capacity, Chunk* prev) {
+        void* raw = ::operator new(sizeof(Chunk) + capacity);
+        return new (raw) Chunk(prev, capacity);
+    }
+
+    static void DeleteChunk(Chunk* chunk) {
+        chunk->~Chunk();
+        ::operator delete(chunk);
+    }
+
+    static void DeleteChain(Chunk* chunk) {
+        while (chunk != nullptr) {
+            Chunk* prev = chunk->prev_;
+            DeleteChunk(chunk);
+            chunk = prev;
+        }
+    }
+
+    // Called by every thread that overran `full`; only one CAS wins, the
+    // others throw their speculative chunk away and retry on the winner's.
+    void Grow(Chunk* full, const size_t block_size) {
+        if (!growable_) {
+            throw std::bad_alloc();
+        }
+        if (current_.load() != full) {
+            return;
+        }
+        Chunk* fresh = NewChunk(std::max(chunk_capacity_, block_size), full);
+        if (!current_.compare_exchange_strong(full, fresh)) {
+            DeleteChunk(fresh);
+        }
     }
 
 private:
-    unsigned char* arena_;
-    std::atomic<size_t> next_offset_{0};
+    const size_t chunk_capacity_;
+    const bool growable_;
+    const size_t slab_size_;
+    const uint64_t id_;
+    std::shared_ptr<Shared> shared_;
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<Chunk*> current_;
 };
 
 ///////////////////////////////////////////////////////////////////////
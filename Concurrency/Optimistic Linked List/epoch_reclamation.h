@@ -0,0 +1,266 @@
+#pragma once
+
+#include "arena_allocator.h"
+#include "../Cache Line/CacheLine.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////
+
+// Epoch-based reclamation (Fraser). Readers of a lock-free structure
+// wrap each operation in an EpochGuard, which publishes the global epoch
+// in the thread's record: one store and one fence per operation, nothing
+// per node visited. A node unlinked from the structure is Retire'd
+// under the epoch current at that time and reclaimed once the global
+// epoch is two ahead, which it can only get after every thread inside a
+// guard has seen the newer one, so after nobody can still hold a pointer
+// to it.
+//
+// Each structure owns its domain, so its retired nodes never outlive it:
+// the domain's destructor reclaims whatever is left, and the structure's
+// arena must still be alive at that point. Reclaiming arena nodes means
+// destroying them and handing the block to ArenaAllocator::Recycle,
+// where the retiring thread's next allocations pick it up again.
+//
+// A thread that stalls inside a guard holds back reclamation, not
+// progress: the others keep retiring, and their lists grow meanwhile.
+class EpochDomain {
+private:
+    struct Retired {
+        void* object_;
+        void (*reclaim_)(void* object, void* context);
+        void* context_;
+        uint64_t epoch_;
+    };
+
+    // One per thread that has used the domain. Records are never freed
+    // while the domain lives; a thread that exits leaves its record,
+    // retired nodes included, to the next thread that needs one.
+    struct alignas(kCacheLineSize) Record {
+        std::atomic<uint64_t> announced_{kQuiescent};    // epoch << 1 | 1 while in a guard
+        std::atomic<bool> owned_{true};
+        std::atomic<size_t> pending_{0};                 // retired_.size(), for other threads
+        Record* next_{nullptr};
+
+        // Touched by the owning thread only.
+        size_t depth_{0};
+        size_t retired_since_advance_{0};
+        std::deque<Retired> retired_;
+    };
+
+    struct Registry {
+        std::atomic<Record*> head_{nullptr};
+        std::atomic<bool> alive_{true};
+
+        ~Registry() {
+            Record* record = head_.load();
+            while (record != nullptr) {
+                Record* next = record->next_;
+                delete record;
+                record = next;
+            }
+        }
+    };
+
+public:
+    EpochDomain()
+        : id_(NextDomainId()),
+          registry_(std::make_shared<Registry>())
+    {}
+
+    EpochDomain(const EpochDomain& /* that */) = delete;
+    EpochDomain& operator=(const EpochDomain& /* that */) = delete;
+
+    // No thread may be inside a guard or retiring anymore.
+    ~EpochDomain() {
+        registry_->alive_.store(false);
+        for (Record* record = registry_->head_.load(); record != nullptr; record = record->next_) {
+            for (const Retired& retired : record->retired_) {
+                retired.reclaim_(retired.object_, retired.context_);
+            }
+            record->retired_.clear();
+            record->pending_.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // object will be passed to reclaim(object, context) once no guard
+    // entered before this call is still open.
+    void Retire(void* object, void (*reclaim)(void* object, void* context), void* context) {
+        Record& record = LocalRecord();
+        record.retired_.push_back(Retired{object, reclaim, context, epoch_.load(std::memory_order_acquire)});
+        record.pending_.store(record.retired_.size(), std::memory_order_relaxed);
+        if (++record.retired_since_advance_ >= kAdvanceInterval) {
+            record.retired_since_advance_ = 0;
+            TryAdvance();
+        }
+        Reclaim(record);
+    }
+
+    // Destroys object and recycles its block into arena, which it must
+    // have been allocated from.
+    template <typename TObject>
+    void Retire(TObject* object, ArenaAllocator& arena) {
+        Retire(object, &ReclaimInArena<TObject>, &arena);
+    }
+
+    // Nodes retired but not reclaimed yet, across all threads. Safe to
+    // call while others retire, but only exact while nobody does.
+    size_t PendingCount() const {
+        size_t pending = 0;
+        for (Record* record = registry_->head_.load(std::memory_order_acquire); record != nullptr; record = record->next_) {
+            pending += record->pending_.load(std::memory_order_relaxed);
+        }
+        return pending;
+    }
+
+private:
+    friend class EpochGuard;
+
+    static constexpr uint64_t kQuiescent = 0;
+    static constexpr size_t kAdvanceInterval = 64;
+
+    static uint64_t NextDomainId() {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1);
+    }
+
+    template <typename TObject>
+    static void ReclaimInArena(void* object, void* arena) {
+        static_cast<TObject*>(object)->~TObject();
+        static_cast<ArenaAllocator*>(arena)->Recycle(object, sizeof(TObject));
+    }
+
+    Record& Enter() {
+        Record& record = LocalRecord();
+        if (record.depth_++ == 0) {
+            // Release, like the store in Exit, so that whoever sees the new
+            // value has seen everything this thread did in earlier guards.
+            record.announced_.store(epoch_.load(std::memory_order_relaxed) << 1 | 1, std::memory_order_release);
+            // Orders the announcement before every load of the
+            // structure; pairs with the fence in TryAdvance.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        return record;
+    }
+
+    static void Exit(Record& record) {
+        if (--record.depth_ == 0) {
+            record.announced_.store(kQuiescent, std::memory_order_release);
+        }
+    }
+
+    // Moves the epoch on if every thread inside a guard has seen the
+    // current one.
+    void TryAdvance() {
+        uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (Record* record = registry_->head_.load(std::memory_order_acquire); record != nullptr; record = record->next_) {
+            const uint64_t announced = record->announced_.load(std::memory_order_acquire);
+            if (announced != kQuiescent && (announced >> 1) != epoch) {
+                return;
+            }
+        }
+        epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+    }
+
+    // Retired entries are in epoch order, so the safe ones are a prefix.
+    void Reclaim(Record& record) {
+        const uint64_t epoch = epoch_.load(std::memory_order_acquire);
+        while (!record.retired_.empty() && record.retired_.front().epoch_ + 2 <= epoch) {
+            const Retired retired = record.retired_.front();
+            record.retired_.pop_front();
+            retired.reclaim_(retired.object_, retired.context_);
+        }
+        record.pending_.store(record.retired_.size(), std::memory_order_relaxed);
+    }
+
+    // The calling thread's records, one per domain it has used. Holding
+    // the registry keeps a record valid for the release at thread exit
+    // even if its domain is gone by then.
+    struct ThreadRecords {
+        struct Entry {
+            uint64_t domain_id_;
+            std::shared_ptr<Registry> registry_;
+            Record* record_;
+        };
+
+        std::vector<Entry> entries_;
+
+        ~ThreadRecords() {
+            for (const Entry& entry : entries_) {
+                entry.record_->owned_.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    Record& LocalRecord() {
+        static thread_local ThreadRecords local;
+        for (const auto& entry : local.entries_) {
+            if (entry.domain_id_ == id_) {
+                return *entry.record_;
+            }
+        }
+
+        // Forget domains that have been destroyed before adding this one.
+        std::vector<ThreadRecords::Entry>& entries = local.entries_;
+        for (size_t i = 0; i < entries.size(); ) {
+            if (!entries[i].registry_->alive_.load(std::memory_order_relaxed)) {
+                entries[i] = std::move(entries.back());
+                entries.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        Record* record = AcquireRecord();
+        entries.push_back(ThreadRecords::Entry{id_, registry_, record});
+        return *record;
+    }
+
+    Record* AcquireRecord() {
+        for (Record* record = registry_->head_.load(std::memory_order_acquire); record != nullptr; record = record->next_) {
+            bool owned = false;
+            if (!record->owned_.load(std::memory_order_relaxed) &&
+                record->owned_.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+        Record* record = new Record();
+        Record* head = registry_->head_.load(std::memory_order_relaxed);
+        do {
+            record->next_ = head;
+        } while (!registry_->head_.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+        return record;
+    }
+
+private:
+    const uint64_t id_;
+    std::shared_ptr<Registry> registry_;
+    alignas(kCacheLineSize) std::atomic<uint64_t> epoch_{1};
+};
+
+// Marks the calling thread as reading the domain's structure for its
+// lifetime; guards nest.
+class EpochGuard {
+public:
+    explicit EpochGuard(EpochDomain& domain)
+        : record_(domain.Enter())
+    {}
+
+    EpochGuard(const EpochGuard& /* that */) = delete;
+    EpochGuard& operator=(const EpochGuard& /* that */) = delete;
+
+    ~EpochGuard() {
+        EpochDomain::Exit(record_);
+    }
+
+private:
+    EpochDomain::Record& record_;
+};
+
+///////////////////////////////////////////////////////////////////////
@@ -0,0 +1,120 @@
+//
+//  numa_arena_allocator.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#pragma once
+
+#include "arena_allocator.h"
+#include "../Thread Pool/Topology.h"
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////
+
+// One growable ArenaAllocator per NUMA node (see CpuTopology); every
+// allocation is served by the arena of the node the calling thread runs
+// on, so tasks on pinned ThreadPool workers get node-local nodes.
+//
+// Chunks are big enough to come straight from mmap, and Linux places a
+// page on the node of the thread that first writes it. Each node's arena
+// is therefore built on a thread pinned to that node, which writes the
+// first chunk's header. Later chunks and the objects in them are first
+// written by whichever thread allocates from the arena, normally one of
+// the node's own, so placement is best-effort: a thread that migrates
+// between CurrentNode() and the write, or a caller of NodeArena() on
+// another node, puts pages off node. Objects served by different arenas
+// never share a page or a cache line.
+class NumaArenaAllocator {
+public:
+    explicit NumaArenaAllocator(const size_t capacity_per_node = 4 * 1024 * 1024,
+                                const size_t slab_size = ArenaAllocator::kDefaultSlabSize)
+        : topology_(CpuTopology::Get())
+    {
+        arenas_.resize(topology_.NumNodes());
+        if (arenas_.size() == 1) {
+            arenas_[0].reset(new ArenaAllocator(capacity_per_node, /*growable=*/true, slab_size));
+            return;
+        }
+        for (size_t i = 0; i < arenas_.size(); ++i) {
+            std::exception_ptr error;
+            std::thread builder([&, i]() {
+                CpuTopology::PinCurrentThread(topology_.Nodes()[i].cpus);
+                try {
+                    arenas_[i].reset(new ArenaAllocator(capacity_per_node, /*growable=*/true, slab_size));
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            });
+            builder.join();
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    NumaArenaAllocator(const NumaArenaAllocator& /* that */) = delete;
+    NumaArenaAllocator(NumaArenaAllocator&& /* that */) = delete;
+
+    template <typename TObject>
+    void* Allocate(const size_t alignment = alignof(TObject)) {
+        return LocalArena().Allocate<TObject>(alignment);
+    }
+
+    template <typename TObject, typename... Args>
+    TObject* New(Args&&... args) {
+        return LocalArena().New<TObject>(std::forward<Args>(args)...);
+    }
+
+    // The arena of the calling thread's node, e.g. for an
+    // OptimisticLinkedSet built by one node's workers. CurrentNode() is
+    // always one of the topology's nodes; at() checks it like NodeArena.
+    ArenaAllocator& LocalArena() {
+        return *arenas_.at(topology_.CurrentNode());
+    }
+
+    ArenaAllocator& NodeArena(const size_t node) {
+        return *arenas_.at(node);
+    }
+
+    size_t NumNodes() const {
+        return arenas_.size();
+    }
+
+    // Same contract as ArenaAllocator::Reset, for every node.
+    void Reset() {
+        for (auto& arena : arenas_) {
+            arena->Reset();
+        }
+    }
+
+    size_t SpaceUsed() const {
+        size_t used = 0;
+        for (auto& arena : arenas_) {
+            used += arena->SpaceUsed();
+        }
+        return used;
+    }
+
+    size_t SpaceReserved() const {
+        size_t reserved = 0;
+        for (auto& arena : arenas_) {
+            reserved += arena->SpaceReserved();
+        }
+        return reserved;
+    }
+
+private:
+    const CpuTopology& topology_;
+    std::vector<std::unique_ptr<ArenaAllocator>> arenas_;
+};
+
+///////////////////////////////////////////////////////////////////////
@@ -0,0 +1,332 @@
+#pragma once
+
+#include "arena_allocator.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define OBJECT_POOL_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define OBJECT_POOL_ASAN 1
+#endif
+#endif
+
+#if defined(OBJECT_POOL_ASAN)
+#include <sanitizer/asan_interface.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////
+
+// Fixed-size blocks for one type, carved from an ArenaAllocator and
+// reused after Delete. Every thread keeps its own free list per pool, so
+// New and Delete are a thread-local pop and push. A thread whose list
+// grows past 2 * kBatchSize hands kBatchSize blocks to the pool's global
+// list with one CAS; a thread whose list runs dry takes the whole global
+// list with one exchange before it goes to the arena, so blocks freed by
+// consumers flow back to producers. Taking everything at once is what
+// keeps the global list free of ABA.
+//
+// With poisoning on (the default unless NDEBUG), a deleted block is
+// filled with kPoisonByte, checked again when it is handed out, and, in
+// AddressSanitizer builds, marked unaddressable meanwhile, so use after
+// Delete is caught at the faulty access or at the latest by the next New.
+//
+// Objects still alive when the pool goes away are not destroyed; their
+// memory returns with the arena. A thread that exits gives its list back
+// to the global one if the pool still exists.
+template <typename TObject>
+class ObjectPool {
+public:
+    static constexpr size_t kBatchSize = 32;
+    static constexpr unsigned char kPoisonByte = 0xDD;
+#if defined(NDEBUG)
+    static constexpr bool kPoisonByDefault = false;
+#else
+    static constexpr bool kPoisonByDefault = true;
+#endif
+
+    explicit ObjectPool(const bool poison = kPoisonByDefault)
+        : owned_arena_(std::make_unique<ArenaAllocator>(kOwnedChunkSize, /*growable=*/true, ArenaAllocator::kDefaultSlabSize)),
+          arena_(*owned_arena_),
+          poison_(poison),
+          id_(NextPoolId()),
+          shared_(std::make_shared<Shared>())
+    {}
+
+    // arena must outlive the pool.
+    explicit ObjectPool(ArenaAllocator& arena, const bool poison = kPoisonByDefault)
+        : arena_(arena),
+          poison_(poison),
+          id_(NextPoolId()),
+          shared_(std::make_shared<Shared>())
+    {}
+
+    ObjectPool(const ObjectPool& /* that */) = delete;
+    ObjectPool& operator=(const ObjectPool& /* that */) = delete;
+
+    // No other thread may use the pool anymore.
+    ~ObjectPool() {
+        std::lock_guard<std::mutex> lock(shared_->mutex_);
+        shared_->alive_ = false;
+    }
+
+    template <typename... Args>
+    TObject* New(Args&&... args) {
+        void* block = Allocate();
+        try {
+            return new (block) TObject(std::forward<Args>(args)...);
+        } catch (...) {
+            Deallocate(block);
+            throw;
+        }
+    }
+
+    void Delete(TObject* object) {
+        if (object == nullptr) {
+            return;
+        }
+        object->~TObject();
+        Deallocate(object);
+    }
+
+    // Raw storage for one TObject.
+    void* Allocate() {
+        Cache& cache = LocalCache();
+        if (cache.head_ == nullptr) {
+            Refill(cache);
+            if (cache.head_ == nullptr) {
+                return arena_.Allocate<Block>();
+            }
+        }
+        FreeBlock* block = cache.head_;
+        cache.head_ = block->next_;
+        cache.count_--;
+        if (poison_) {
+            CheckPoison(block);
+        }
+        return block;
+    }
+
+    // block must come from Allocate of this pool, by any thread.
+    void Deallocate(void* block) {
+        if (poison_) {
+            Poison(block);
+        }
+        Cache& cache = LocalCache();
+        FreeBlock* free_block = static_cast<FreeBlock*>(block);
+        free_block->next_ = cache.head_;
+        cache.head_ = free_block;
+        if (++cache.count_ >= 2 * kBatchSize) {
+            Spill(cache);
+        }
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next_;
+    };
+
+    union Block {
+        FreeBlock free_;
+        typename std::aligned_storage<sizeof(TObject), alignof(TObject)>::type object_;
+    };
+
+    // What outlives the pool for the sake of exiting threads.
+    struct Shared {
+        std::atomic<FreeBlock*> global_{nullptr};
+        std::mutex mutex_;
+        bool alive_{true};
+    };
+
+    struct Cache {
+        uint64_t pool_id_;
+        std::shared_ptr<Shared> shared_;
+        FreeBlock* head_;
+        size_t count_;
+    };
+
+    // The calling thread's lists, one per pool of this type it has used.
+    struct ThreadCaches {
+        std::vector<Cache> caches_;
+
+        ~ThreadCaches() {
+            for (Cache& cache : caches_) {
+                if (cache.head_ == nullptr) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(cache.shared_->mutex_);
+                if (cache.shared_->alive_) {
+                    PushChain(*cache.shared_, cache.head_, Last(cache.head_));
+                }
+            }
+        }
+    };
+
+    static constexpr size_t kOwnedChunkSize = 1024 * 1024;
+    static constexpr size_t kPoisonOffset = sizeof(FreeBlock);
+
+    static uint64_t NextPoolId() {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1);
+    }
+
+    Cache& LocalCache() {
+        static thread_local ThreadCaches local;
+        for (Cache& cache : local.caches_) {
+            if (cache.pool_id_ == id_) {
+                return cache;
+            }
+        }
+
+        // Forget pools that have been destroyed before adding this one.
+        std::vector<Cache>& caches = local.caches_;
+        for (size_t i = 0; i < caches.size(); ) {
+            bool alive;
+            {
+                std::lock_guard<std::mutex> lock(caches[i].shared_->mutex_);
+                alive = caches[i].shared_->alive_;
+            }
+            if (!alive) {
+                caches[i] = std::move(caches.back());
+                caches.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        caches.push_back(Cache{id_, shared_, nullptr, 0});
+        return caches.back();
+    }
+
+    static FreeBlock* Last(FreeBlock* block) {
+        while (block->next_ != nullptr) {
+            block = block->next_;
+        }
+        return block;
+    }
+
+    static void PushChain(Shared& shared, FreeBlock* first, FreeBlock* last) {
+        FreeBlock* head = shared.global_.load(std::memory_order_relaxed);
+        do {
+            last->next_ = head;
+        } while (!shared.global_.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Moves the kBatchSize most recently freed blocks to the global list.
+    void Spill(Cache& cache) {
+        FreeBlock* first = cache.head_;
+        FreeBlock* last = first;
+        for (size_t i = 1; i < kBatchSize; i++) {
+            last = last->next_;
+        }
+        cache.head_ = last->next_;
+        cache.count_ -= kBatchSize;
+        PushChain(*shared_, first, last);
+    }
+
+    void Refill(Cache& cache) {
+        if (shared_->global_.load(std::memory_order_relaxed) == nullptr) {
+            return;
+        }
+        FreeBlock* taken = shared_->global_.exchange(nullptr, std::memory_order_acquire);
+        size_t count = 0;
+        for (FreeBlock* block = taken; block != nullptr; block = block->next_) {
+            count++;
+        }
+        cache.head_ = taken;
+        cache.count_ = count;
+    }
+
+    // The link stays addressable: it is what the free lists walk.
+    void Poison(void* block) const {
+        unsigned char* bytes = static_cast<unsigned char*>(block);
+        std::memset(bytes + kPoisonOffset, kPoisonByte, sizeof(Block) - kPoisonOffset);
+#if defined(OBJECT_POOL_ASAN)
+        ASAN_POISON_MEMORY_REGION(bytes + kPoisonOffset, sizeof(Block) - kPoisonOffset);
+#endif
+    }
+
+    void CheckPoison(void* block) const {
+        unsigned char* bytes = static_cast<unsigned char*>(block);
+#if defined(OBJECT_POOL_ASAN)
+        ASAN_UNPOISON_MEMORY_REGION(bytes + kPoisonOffset, sizeof(Block) - kPoisonOffset);
+#endif
+        for (size_t i = kPoisonOffset; i < sizeof(Block); i++) {
+            if (bytes[i] != kPoisonByte) {
+                std::fprintf(stderr, "ObjectPool: block %p was written to after Delete\n", block);
+                std::abort();
+            }
+        }
+    }
+
+private:
+    std::unique_ptr<ArenaAllocator> owned_arena_;
+    ArenaAllocator& arena_;
+    const bool poison_;
+    const uint64_t id_;
+    std::shared_ptr<Shared> shared_;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+// Standard allocator over one process-wide ObjectPool per type, meant for
+// node-based containers: a rebound std::list or std::forward_list asks
+// for one node at a time, and those requests come from the pool. Array
+// requests (a deque's blocks, a vector) go to std::allocator. Stateless,
+// so all instances are interchangeable. The shared pools are never
+// destroyed, which keeps containers with static storage duration safe to
+// tear down at exit.
+template <typename TObject>
+class PoolAllocator {
+public:
+    using value_type = TObject;
+
+    PoolAllocator() noexcept = default;
+
+    template <typename TOther>
+    PoolAllocator(const PoolAllocator<TOther>& /* that */) noexcept {}
+
+    TObject* allocate(const size_t count) {
+        if (count == 1) {
+            return static_cast<TObject*>(Pool().Allocate());
+        }
+        return std::allocator<TObject>().allocate(count);
+    }
+
+    void deallocate(TObject* object, const size_t count) {
+        if (count == 1) {
+            Pool().Deallocate(object);
+            return;
+        }
+        std::allocator<TObject>().deallocate(object, count);
+    }
+
+    static ObjectPool<TObject>& Pool() {
+        static ObjectPool<TObject>* pool = new ObjectPool<TObject>();
+        return *pool;
+    }
+};
+
+template <typename TObject, typename TOther>
+bool operator==(const PoolAllocator<TObject>& /* lhs */, const PoolAllocator<TOther>& /* rhs */) {
+    return true;
+}
+
+template <typename TObject, typename TOther>
+bool operator!=(const PoolAllocator<TObject>& /* lhs */, const PoolAllocator<TOther>& /* rhs */) {
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "arena_allocator.h"
+#include "epoch_reclamation.h"
+#include "ttas_spinlock.h"
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+
+///////////////////////////////////////////////////////////////////////
+
+// Sentinel values for the head and tail nodes; they must never be
+// inserted. Specialize for element types without numeric_limits.
+template <typename T>
+struct KeyTraits {
+    static T LowerBound() {
+        return std::numeric_limits<T>::lowest();
+    }
+
+    static T UpperBound() {
+        return std::numeric_limits<T>::max();
+    }
+};
+
+///////////////////////////////////////////////////////////////////////
+
+// Sorted set on a singly linked list with lazy synchronization
+// (Heller et al.): traversals take no locks, Insert/Remove lock the
+// nodes around the edge they change and re-validate it, and removal
+// first marks a node logically deleted, which makes Contains wait-free.
+//
+// Nodes come from the arena. Every operation runs inside an EpochGuard
+// and Remove retires the node it unlinks, so a reader that raced with
+// Remove can always finish walking it; once no such reader is left the
+// node is recycled into the arena for later Inserts. The arena must
+// outlive the set. Give the arena a slab size (see ArenaAllocator) when
+// several threads insert at once, so node allocation stays thread-local.
+template <typename T, class TTraits = KeyTraits<T>>
+class OptimisticLinkedSet {
+private:
+    struct Node {
+        T element_;
+        std::atomic<Node*> next_;
+        TTASSpinLock lock_{};
+        std::atomic<bool> marked_{false};
+
+        Node(const T& element, Node* next = nullptr)
+            : element_(element),
+              next_(next) {
+        }
+    };
+
+    struct Edge {
+        Node* pred_;
+        Node* curr_;
+
+        Edge(Node* pred, Node* curr)
+            : pred_(pred),
+              curr_(curr) {
+        }
+    };
+
+public:
+    explicit OptimisticLinkedSet(ArenaAllocator& allocator)
+        : allocator_(allocator) {
+        CreateEmptyList();
+    }
+
+    OptimisticLinkedSet(const OptimisticLinkedSet& /* that */) = delete;
+    OptimisticLinkedSet& operator=(const OptimisticLinkedSet& /* that */) = delete;
+
+    bool Insert(const T& element) {
+        EpochGuard guard(domain_);
+        while (true) {
+            Edge edge = Locate(element);
+            // Holding pred is enough: unlinking curr needs pred's lock too.
+            std::lock_guard<TTASSpinLock> pred_lock(edge.pred_->lock_);
+            if (!Validate(edge)) {
+                continue;
+            }
+            if (edge.curr_->element_ == element) {
+                return false;
+            }
+
+            Node* node = allocator_.New<Node>(element, edge.curr_);
+            edge.pred_->next_.store(node, std::memory_order_release);
+            size_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    bool Remove(const T& element) {
+        EpochGuard guard(domain_);
+        while (true) {
+            Edge edge = Locate(element);
+            std::lock_guard<TTASSpinLock> pred_lock(edge.pred_->lock_);
+            std::lock_guard<TTASSpinLock> curr_lock(edge.curr_->lock_);
+            if (!Validate(edge)) {
+                continue;
+            }
+            if (edge.curr_->element_ != element) {
+                return false;
+            }
+
+            edge.curr_->marked_.store(true, std::memory_order_release);
+            edge.pred_->next_.store(edge.curr_->next_.load(std::memory_order_relaxed),
+                                    std::memory_order_release);
+            size_.fetch_sub(1, std::memory_order_relaxed);
+            // Both locks are released after this, inside the guard, so
+            // the node cannot be reclaimed under them.
+            domain_.Retire(edge.curr_, allocator_);
+            return true;
+        }
+    }
+
+    bool Contains(const T& element) const {
+        EpochGuard guard(domain_);
+        const Edge edge = Locate(element);
+        return edge.curr_->element_ == element &&
+               !edge.curr_->marked_.load(std::memory_order_acquire);
+    }
+
+    size_t Size() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+private:
+    void CreateEmptyList() {
+        head_ = allocator_.New<Node>(TTraits::LowerBound());
+        head_->next_ = allocator_.New<Node>(TTraits::UpperBound());
+    }
+
+    // Finds pred < element <= curr without taking any locks.
+    Edge Locate(const T& element) const {
+        Node* pred = head_;
+        Node* curr = pred->next_.load(std::memory_order_acquire);
+        while (curr->element_ < element) {
+            pred = curr;
+            curr = curr->next_.load(std::memory_order_acquire);
+        }
+        return Edge{pred, curr};
+    }
+
+    // Must be called with the edge's locks held.
+    bool Validate(const Edge& edge) const {
+        return !edge.pred_->marked_.load(std::memory_order_relaxed) &&
+               !edge.curr_->marked_.load(std::memory_order_relaxed) &&
+               edge.pred_->next_.load(std::memory_order_relaxed) == edge.curr_;
+    }
+
+private:
+    ArenaAllocator& allocator_;
+    mutable EpochDomain domain_;
+    Node* head_{nullptr};
+    std::atomic<size_t> size_{0};
+};
+
+///////////////////////////////////////////////////////////////////////
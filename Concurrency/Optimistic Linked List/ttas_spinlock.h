@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../Spin Wait/SpinWait.h"
+
+#include <atomic>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////
+
+// Test-and-test-and-set spinlock: waiters spin on a plain load, so the
+// cache line stays shared until the owner releases it. Meets the
+// Lockable requirements and works with std::unique_lock.
+class TTASSpinLock {
+public:
+    TTASSpinLock() = default;
+
+    TTASSpinLock(const TTASSpinLock& /* that */) = delete;
+    TTASSpinLock& operator=(const TTASSpinLock& /* that */) = delete;
+
+    void lock() {
+        size_t spins = 0;
+        while (locked_.exchange(true, std::memory_order_acquire)) {
+            while (locked_.load(std::memory_order_relaxed)) {
+                if (++spins % kYieldPeriod == 0) {
+                    std::this_thread::yield();
+                } else {
+                    cpu_relax();
+                }
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !locked_.load(std::memory_order_relaxed) &&
+               !locked_.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        locked_.store(false, std::memory_order_release);
+    }
+
+private:
+    static const size_t kYieldPeriod = 64;
+
+    std::atomic<bool> locked_{false};
+};
+
+///////////////////////////////////////////////////////////////////////
@@ -0,0 +1,259 @@
+//
+//  ReadWriteLock.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef ReadWriteLock_h
+#define ReadWriteLock_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "../Cache Line/CacheLine.h"
+#include "../Spin Wait/SpinWait.h"
+
+// All locks here expose ReadLock/ReadUnlock/WriteLock/WriteUnlock and
+// prefer writers: once a writer is waiting, new readers hold back.
+
+// The classic lock: every operation goes through one mutex.
+class ReadWriteLock {
+public:
+    ReadWriteLock() {
+        writers_.store(0);
+        readers_.store(0);
+        write_state.store(false);
+    }
+    
+    void ReadLock() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        read_cv_.wait(lock, [this](){ return !writers_.load(); });
+        readers_.fetch_add(1);
+    }
+    
+    void ReadUnlock() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        readers_.fetch_sub(1);
+        if (readers_.load() == 0)
+            write_cv_.notify_one();
+    }
+    
+    void WriteLock() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        writers_.fetch_add(1);
+        write_cv_.wait(lock, [this](){ return readers_.load() == 0 && !write_state; });
+        write_state.store(true);
+    }
+    
+    void WriteUnlock() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        writers_.fetch_sub(1);
+        write_state.store(false);
+        write_cv_.notify_one();
+        read_cv_.notify_all();
+    }
+    
+private:
+    std::atomic<size_t> writers_;
+    std::atomic<size_t> readers_;
+    std::atomic<bool> write_state;
+    
+    std::condition_variable read_cv_;
+    std::condition_variable write_cv_;
+    
+    std::mutex mutex_;
+};
+
+// Parks threads on a condition variable, but only touches the mutex when
+// somebody is actually asleep. The waker must change the state a sleeper
+// waits on with a seq_cst operation before calling Wake.
+class ParkingLot {
+public:
+    template <class Predicate>
+    void Park(Predicate ready) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1);
+        cv_.wait(lock, ready);
+        sleepers_.fetch_sub(1);
+    }
+    
+    void Wake() {
+        if (sleepers_.load()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_all();
+        }
+    }
+    
+private:
+    std::atomic<uint32_t> sleepers_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+// One atomic word holds the writer bit, a writer-waiting bit and the
+// reader count, so an uncontended ReadLock or WriteLock is a single CAS
+// and never touches the mutex. Contended callers spin for kSpinLimit
+// rounds before they park.
+class AdaptiveReadWriteLock {
+public:
+    AdaptiveReadWriteLock() = default;
+    
+    AdaptiveReadWriteLock(const AdaptiveReadWriteLock& other) = delete;
+    AdaptiveReadWriteLock& operator=(const AdaptiveReadWriteLock& other) = delete;
+    
+    void ReadLock() {
+        std::size_t spins = 0;
+        while (true) {
+            uint32_t state = state_.load(std::memory_order_relaxed);
+            if (!(state & (kWriter | kWriterWaiting))) {
+                if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire))
+                    return;
+                continue;
+            }
+            if (spins++ < kSpinLimit) {
+                cpu_relax();
+                continue;
+            }
+            lot_.Park([this](){ return !(state_.load() & (kWriter | kWriterWaiting)); });
+        }
+    }
+    
+    void ReadUnlock() {
+        const uint32_t state = state_.fetch_sub(1);
+        if ((state & kReaders) == 1 && (state & kWriterWaiting))
+            lot_.Wake();
+    }
+    
+    void WriteLock() {
+        std::size_t spins = 0;
+        while (true) {
+            uint32_t state = state_.load(std::memory_order_relaxed);
+            if (!(state & (kWriter | kReaders))) {
+                if (state_.compare_exchange_weak(state, kWriter, std::memory_order_acquire))
+                    return;
+                continue;
+            }
+            if (!(state & kWriterWaiting))
+                state_.fetch_or(kWriterWaiting);
+            if (spins++ < kSpinLimit) {
+                cpu_relax();
+                continue;
+            }
+            lot_.Park([this](){ return !(state_.load() & (kWriter | kReaders)); });
+        }
+    }
+    
+    void WriteUnlock() {
+        state_.fetch_and(~kWriter);
+        lot_.Wake();
+    }
+    
+private:
+    static constexpr uint32_t kWriter = 1u << 31;
+    static constexpr uint32_t kWriterWaiting = 1u << 30;
+    static constexpr uint32_t kReaders = kWriterWaiting - 1;
+    static constexpr std::size_t kSpinLimit = 128;
+    
+    std::atomic<uint32_t> state_{0};
+    ParkingLot lot_;
+};
+
+// "Big reader" lock: readers count themselves on one of several padded
+// slots, so readers running on different cores never write the same
+// cache line. Threads get slots round-robin on first use. The price is
+// paid by writers, which have to check every slot.
+class BigReaderLock {
+public:
+    explicit BigReaderLock(const std::size_t num_slots = default_num_slots()): num_slots_(num_slots ? num_slots : 1), slots_(new Slot[num_slots_]) {}
+    
+    BigReaderLock(const BigReaderLock& other) = delete;
+    BigReaderLock& operator=(const BigReaderLock& other) = delete;
+    
+    void ReadLock() {
+        Slot& slot = slots_[thread_slot() % num_slots_];
+        std::size_t spins = 0;
+        while (true) {
+            slot.readers.fetch_add(1);
+            if (!writer_.load())
+                return;
+            
+            // A writer is in or on its way: back off so it can see zero.
+            if (slot.readers.fetch_sub(1) == 1)
+                lot_.Wake();
+            while (writer_.load()) {
+                if (spins++ < kSpinLimit) {
+                    cpu_relax();
+                    continue;
+                }
+                lot_.Park([this](){ return !writer_.load(); });
+            }
+        }
+    }
+    
+    void ReadUnlock() {
+        Slot& slot = slots_[thread_slot() % num_slots_];
+        if (slot.readers.fetch_sub(1) == 1 && writer_.load())
+            lot_.Wake();
+    }
+    
+    void WriteLock() {
+        std::size_t spins = 0;
+        bool expected = false;
+        while (!writer_.compare_exchange_weak(expected, true)) {
+            expected = false;
+            if (spins++ < kSpinLimit) {
+                cpu_relax();
+                continue;
+            }
+            lot_.Park([this](){ return !writer_.load(); });
+        }
+        
+        for (std::size_t i = 0; i < num_slots_; i++) {
+            Slot& slot = slots_[i];
+            spins = 0;
+            while (slot.readers.load()) {
+                if (spins++ < kSpinLimit) {
+                    cpu_relax();
+                    continue;
+                }
+                lot_.Park([&slot](){ return !slot.readers.load(); });
+            }
+        }
+    }
+    
+    void WriteUnlock() {
+        writer_.store(false);
+        lot_.Wake();
+    }
+    
+private:
+    static constexpr std::size_t kSpinLimit = 128;
+    
+    struct alignas(kCacheLineSize) Slot {
+        std::atomic<uint32_t> readers{0};
+    };
+    
+    static std::size_t thread_slot() {
+        static std::atomic<std::size_t> next_slot{0};
+        static thread_local const std::size_t slot = next_slot.fetch_add(1);
+        return slot;
+    }
+    
+    static std::size_t default_num_slots() {
+        std::size_t cores = std::thread::hardware_concurrency();
+        return cores ? cores : 2;
+    }
+    
+    const std::size_t num_slots_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<bool> writer_{false};
+    ParkingLot lot_;
+};
+
+#endif /* ReadWriteLock_h */
@@ -0,0 +1,47 @@
+//
+//  SpinWait.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef SpinWait_h
+#define SpinWait_h
+
+#include <cstddef>
+#include <thread>
+
+// Tells the core this is a spin-wait loop: pause on x86, yield on ARM.
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}
+
+// How long a waiter that could park keeps watching first: a burst of
+// cpu_relax for a wakeup that is nanoseconds away, then a few yields for
+// one that is a reschedule away. Only then is the futex worth its cost.
+struct SpinWait {
+    static constexpr std::size_t kSpinCount = 64;
+    static constexpr std::size_t kYieldCount = 16;
+
+    // true as soon as ready() holds, false if it still does not once the
+    // budget is spent and the caller should park.
+    template <class Ready>
+    static bool Until(const Ready& ready) {
+        for (std::size_t i = 0; i < kSpinCount + kYieldCount; i++) {
+            if (ready())
+                return true;
+            if (i < kSpinCount)
+                cpu_relax();
+            else
+                std::this_thread::yield();
+        }
+        return ready();
+    }
+};
+
+#endif /* SpinWait_h */
@@ -0,0 +1,174 @@
+//
+//  Stats.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef Stats_h
+#define Stats_h
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "../Cache Line/CacheLine.h"
+
+// Instrumentation shared by the primitives. It is compiled in only with
+// -DCONCURRENCY_STATS; otherwise every counter and histogram below is an
+// empty class whose methods do nothing, StatsNow() never reads the clock,
+// and snapshots are all zero, so instrumented code costs nothing.
+//
+// Recording is sharded: every thread adds to its own cache line of a
+// counter, so hot paths do not bounce one line between cores. Snapshots
+// sum the shards with relaxed loads while the structure keeps running;
+// they are not atomic across counters.
+
+#if defined(CONCURRENCY_STATS)
+constexpr bool kStatsEnabled = true;
+#else
+constexpr bool kStatsEnabled = false;
+#endif
+
+// Log2 buckets: bucket i counts samples in [2^(i-1), 2^i) ns, bucket 0
+// counts zeros, the last one everything longer.
+struct HistogramSnapshot {
+    static constexpr std::size_t kBuckets = 40;
+
+    std::uint64_t count = 0;
+    std::uint64_t sum_ns = 0;
+    std::array<std::uint64_t, kBuckets> buckets{};
+
+    double MeanNs() const {
+        return count ? static_cast<double>(sum_ns) / count : 0.0;
+    }
+
+    // Upper bound of the bucket holding quantile q in [0, 1].
+    std::uint64_t PercentileNs(const double q) const {
+        const std::uint64_t rank = static_cast<std::uint64_t>(q * count);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; i++) {
+            seen += buckets[i];
+            if (seen > rank)
+                return i ? std::uint64_t(1) << i : 0;
+        }
+        return count ? std::uint64_t(1) << (kBuckets - 1) : 0;
+    }
+};
+
+// BlockingQueue::GetStats(). Blocks count calls that found the queue
+// full (Put) or empty (Get) and had to wait on the condition variable; a
+// Get that the spin before it satisfies is not counted, and neither is
+// the spin's time.
+struct BlockingQueueStats {
+    std::uint64_t put_blocks = 0;
+    std::uint64_t put_blocked_ns = 0;
+    std::uint64_t get_blocks = 0;
+    std::uint64_t get_blocked_ns = 0;
+};
+
+// Nanoseconds on the steady clock; 0 when stats are compiled out.
+inline std::uint64_t StatsNow() {
+    if constexpr (kStatsEnabled)
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    else
+        return 0;
+}
+
+#if defined(CONCURRENCY_STATS)
+
+constexpr std::size_t kStatsShards = 16;
+
+// Threads are dealt shards round-robin the first time they record.
+inline std::size_t StatsShard() {
+    static std::atomic<std::size_t> next{0};
+    static thread_local const std::size_t shard = next.fetch_add(1, std::memory_order_relaxed) % kStatsShards;
+    return shard;
+}
+
+class ShardedCounter {
+public:
+    void Add(const std::uint64_t value = 1) {
+        shards[StatsShard()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    std::uint64_t Load() const {
+        std::uint64_t total = 0;
+        for (const auto& shard : shards)
+            total += shard.value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    struct alignas(kCacheLineSize) Shard {
+        std::atomic<std::uint64_t> value{0};
+    };
+
+    Shard shards[kStatsShards];
+};
+
+class LatencyHistogram {
+public:
+    void Record(const std::uint64_t ns) {
+        Shard& shard = shards[StatsShard()];
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+        shard.buckets[Bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    HistogramSnapshot Snapshot() const {
+        HistogramSnapshot result;
+        for (const auto& shard : shards) {
+            result.count += shard.count.load(std::memory_order_relaxed);
+            result.sum_ns += shard.sum_ns.load(std::memory_order_relaxed);
+            for (std::size_t i = 0; i < HistogramSnapshot::kBuckets; i++)
+                result.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+private:
+    static std::size_t Bucket(std::uint64_t ns) {
+        std::size_t bucket = 0;
+        while (ns && bucket < HistogramSnapshot::kBuckets - 1) {
+            ns >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    struct alignas(kCacheLineSize) Shard {
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::uint64_t> sum_ns{0};
+        std::atomic<std::uint64_t> buckets[HistogramSnapshot::kBuckets] = {};
+    };
+
+    Shard shards[kStatsShards];
+};
+
+#else
+
+class ShardedCounter {
+public:
+    void Add(const std::uint64_t = 1) {}
+
+    std::uint64_t Load() const {
+        return 0;
+    }
+};
+
+class LatencyHistogram {
+public:
+    void Record(const std::uint64_t) {}
+
+    HistogramSnapshot Snapshot() const {
+        return HistogramSnapshot();
+    }
+};
+
+#endif
+
+#endif /* Stats_h */
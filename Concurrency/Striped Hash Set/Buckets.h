@@ -0,0 +1,375 @@
+//
+//  Buckets.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef Buckets_h
+#define Buckets_h
+
+#include <algorithm>
+#include <cstdint>
+#include <forward_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../Optimistic Linked List/object_pool.h"
+
+// Optimistic readers race with writers on purpose and leave it to the
+// stripe's seqlock to discard what they saw. ThreadSanitizer cannot know
+// that, so the probe those readers run is not instrumented.
+#if defined(__SANITIZE_THREAD__)
+#define BUCKETS_OPTIMISTIC_READ __attribute__((no_sanitize_thread))
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define BUCKETS_OPTIMISTIC_READ __attribute__((no_sanitize("thread")))
+#endif
+#endif
+#if !defined(BUCKETS_OPTIMISTIC_READ)
+#define BUCKETS_OPTIMISTIC_READ
+#endif
+
+// Bucket storage policies for StripedHashSet. Every stripe owns one
+// table and only touches it under that stripe's lock, so a policy does
+// not have to be thread-safe itself. Callers pass the element's hash in;
+// the policy keeps a copy of Hash only to re-hash elements on Resize.
+//
+// Required surface:
+//     Policy(size_t num_buckets, const Hash& hash)
+//     bool Contains(const T&, size_t hash_value) const
+//     bool Insert(const T&, size_t hash_value)   // element is not present
+//     bool Remove(const T&, size_t hash_value)
+//     void Resize(size_t num_buckets)
+//     void MigrateBuckets(size_t first, size_t last, Policy& target)
+//     size_t BucketCount() const
+//     void ChainLengths(std::vector<size_t>& histogram) const
+//     void Prefetch(size_t hash_value) const     // a hint, never faults
+//     static constexpr double kMaxLoadFactor
+//     static constexpr bool kOptimisticReads
+//
+// kOptimisticReads promises that Contains may run concurrently with
+// Insert/Remove/MigrateBuckets on the same table without touching freed
+// memory (it may see garbage, which the caller's seqlock rejects), as
+// long as the table is never Resize'd while visible to such readers.
+//
+// ChainLengths adds the table's occupancy to histogram[k], growing it as
+// needed: buckets holding k elements for chaining, keys found k probes
+// from their home slot for open addressing.
+//
+// Prefetch starts loading whatever Contains(_, hash_value) will touch
+// first, so batched lookups can overlap their cache misses.
+
+// All elements of a stripe share hash % num_stripes, so the raw hash is
+// mixed before it picks a bucket (murmur3 finalizer).
+inline std::size_t MixBucketHash(std::size_t hash_value) {
+    std::uint64_t h = hash_value;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return static_cast<std::size_t>(h);
+}
+
+// Separate chaining, one forward_list per bucket: the original layout.
+// Allocator is used for the chain nodes; see ChainedBuckets and
+// PooledChainedBuckets below.
+template <typename T, class Hash, class Allocator = std::allocator<T>>
+class BasicChainedBuckets {
+public:
+    static constexpr double kMaxLoadFactor = std::numeric_limits<double>::max();
+    static constexpr bool kOptimisticReads = false;
+
+    BasicChainedBuckets(const std::size_t num_buckets, const Hash& hash):
+    hash_(hash),
+    buckets_(std::max<std::size_t>(num_buckets, 1)) {}
+
+    bool Contains(const T& element, const std::size_t hash_value) const {
+        const Chain& bucket = buckets_[GetBucketIndex(hash_value)];
+        return std::find(bucket.begin(), bucket.end(), element) != bucket.end();
+    }
+
+    bool Insert(const T& element, const std::size_t hash_value) {
+        buckets_[GetBucketIndex(hash_value)].push_front(element);
+        return true;
+    }
+
+    bool Remove(const T& element, const std::size_t hash_value) {
+        Chain& bucket = buckets_[GetBucketIndex(hash_value)];
+        auto prev = bucket.before_begin();
+        for (auto it = bucket.begin(); it != bucket.end(); prev = it++) {
+            if (*it == element) {
+                bucket.erase_after(prev);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Resize(const std::size_t num_buckets) {
+        std::vector<Chain> temp(std::max<std::size_t>(num_buckets, 1));
+        for (auto& bucket : buckets_) {
+            for (auto& item : bucket) {
+                const std::size_t bucket_index = MixBucketHash(hash_(item)) % temp.size();
+                temp[bucket_index].push_front(std::move(item));
+            }
+        }
+        buckets_ = std::move(temp);
+    }
+
+    // Moves the chains of buckets [first, last) into target.
+    void MigrateBuckets(const std::size_t first, const std::size_t last, BasicChainedBuckets& target) {
+        for (std::size_t i = first; i < last; i++) {
+            for (auto const &item : buckets_[i])
+                target.Insert(item, hash_(item));
+            buckets_[i].clear();
+        }
+    }
+
+    std::size_t BucketCount() const {
+        return buckets_.size();
+    }
+
+    void Prefetch(const std::size_t hash_value) const {
+        __builtin_prefetch(&buckets_[GetBucketIndex(hash_value)]);
+    }
+
+    void ChainLengths(std::vector<std::size_t>& histogram) const {
+        for (auto const &bucket : buckets_) {
+            const std::size_t length = std::distance(bucket.begin(), bucket.end());
+            if (histogram.size() <= length)
+                histogram.resize(length + 1);
+            histogram[length]++;
+        }
+    }
+
+private:
+    using Chain = std::forward_list<T, Allocator>;
+
+    std::size_t GetBucketIndex(const std::size_t hash_value) const {
+        return MixBucketHash(hash_value) % buckets_.size();
+    }
+
+    Hash hash_;
+    std::vector<Chain> buckets_;
+};
+
+template <typename T, class Hash>
+using ChainedBuckets = BasicChainedBuckets<T, Hash>;
+
+// Chain nodes come from the shared ObjectPool of the node type instead of
+// malloc, so the set's insert/remove churn reuses them.
+template <typename T, class Hash>
+using PooledChainedBuckets = BasicChainedBuckets<T, Hash, PoolAllocator<T>>;
+
+// Open addressing with linear probing for small trivially copyable keys.
+// A byte-wide control array holds a 7-bit hash tag per slot next to a
+// flat array of keys, so a probe scans one line of tags and only reads a
+// key when its tag matches. With SSE2 a lookup compares 16 tags at a
+// time, then checks only the keys whose tags matched. Removal shifts the rest of the probe run
+// back instead of leaving tombstones; only a table being drained by
+// MigrateBuckets uses tombstones, so nothing slips behind its cursor.
+// All updates are in place, which is what makes optimistic reads safe.
+template <typename T, class Hash>
+class OpenAddressingBuckets {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "OpenAddressingBuckets stores keys by value in a flat array");
+
+public:
+    static constexpr double kMaxLoadFactor = 0.75;
+    static constexpr bool kOptimisticReads = true;
+
+    OpenAddressingBuckets(const std::size_t num_buckets, const Hash& hash):
+    hash_(hash) {
+        Allocate(RoundUp(num_buckets));
+    }
+
+    BUCKETS_OPTIMISTIC_READ bool Contains(const T& element, const std::size_t hash_value) const {
+        return Find(element, MixBucketHash(hash_value)) != kNotFound;
+    }
+
+    bool Insert(const T& element, const std::size_t hash_value) {
+        // StripedHashSet grows stripes long before this; it is only a
+        // safety net for direct users of the policy.
+        if ((size_ + tombstones_ + 1) * 8 > control_.size() * 7)
+            Resize(size_ * 2 >= control_.size() ? control_.size() * 2 : control_.size());
+
+        const std::size_t mixed = MixBucketHash(hash_value);
+        std::size_t index = mixed & mask_;
+        while (control_[index] >= kFirstTag)
+            index = (index + 1) & mask_;
+
+        if (control_[index] == kDeleted)
+            tombstones_--;
+        control_[index] = Tag(mixed);
+        slots_[index] = element;
+        size_++;
+        return true;
+    }
+
+    bool Remove(const T& element, const std::size_t hash_value) {
+        std::size_t index = Find(element, MixBucketHash(hash_value));
+        if (index == kNotFound)
+            return false;
+        size_--;
+
+        if (draining_) {
+            control_[index] = kDeleted;
+            tombstones_++;
+            return true;
+        }
+
+        // Backward-shift deletion: pull every later key of the run that
+        // may live at the hole into it, then free the last hole.
+        for (std::size_t next = (index + 1) & mask_; control_[next] != kEmpty; next = (next + 1) & mask_) {
+            const std::size_t home = MixBucketHash(hash_(slots_[next])) & mask_;
+            const bool stays = index <= next ? (index < home && home <= next)
+                                             : (index < home || home <= next);
+            if (stays)
+                continue;
+            slots_[index] = slots_[next];
+            control_[index] = control_[next];
+            index = next;
+        }
+        control_[index] = kEmpty;
+        return true;
+    }
+
+    void Resize(const std::size_t num_buckets) {
+        std::vector<std::uint8_t> old_control = std::move(control_);
+        std::vector<T> old_slots = std::move(slots_);
+
+        Allocate(RoundUp(std::max(num_buckets, size_ * 2)));
+        for (std::size_t i = 0; i < old_control.size(); i++) {
+            if (old_control[i] < kFirstTag)
+                continue;
+
+            std::size_t index = MixBucketHash(hash_(old_slots[i])) & mask_;
+            while (control_[index] != kEmpty)
+                index = (index + 1) & mask_;
+            control_[index] = old_control[i];
+            slots_[index] = old_slots[i];
+            size_++;
+        }
+    }
+
+    // Moves slots [first, last) into target. Migrated slots become
+    // tombstones rather than empty, so probes for keys that were displaced
+    // past `last` still reach them.
+    void MigrateBuckets(const std::size_t first, const std::size_t last, OpenAddressingBuckets& target) {
+        draining_ = true;
+        for (std::size_t i = first; i < last; i++) {
+            if (control_[i] < kFirstTag)
+                continue;
+            target.Insert(slots_[i], hash_(slots_[i]));
+            control_[i] = kDeleted;
+            size_--;
+            tombstones_++;
+        }
+    }
+
+    std::size_t BucketCount() const {
+        return control_.size();
+    }
+
+    void Prefetch(const std::size_t hash_value) const {
+        const std::size_t index = MixBucketHash(hash_value) & mask_;
+        __builtin_prefetch(&control_[index]);
+        __builtin_prefetch(&slots_[index]);
+    }
+
+    void ChainLengths(std::vector<std::size_t>& histogram) const {
+        for (std::size_t i = 0; i < control_.size(); i++) {
+            if (control_[i] < kFirstTag)
+                continue;
+            const std::size_t home = MixBucketHash(hash_(slots_[i])) & mask_;
+            const std::size_t probes = ((i - home) & mask_) + 1;
+            if (histogram.size() <= probes)
+                histogram.resize(probes + 1);
+            histogram[probes]++;
+        }
+    }
+
+private:
+    static constexpr std::uint8_t kEmpty = 0;
+    static constexpr std::uint8_t kDeleted = 1;
+    static constexpr std::uint8_t kFirstTag = 0x80;
+    static constexpr std::size_t kMinSlots = 8;
+    static constexpr std::size_t kNotFound = std::numeric_limits<std::size_t>::max();
+    static constexpr std::size_t kGroupSize = 16;
+
+    static std::uint8_t Tag(const std::size_t mixed) {
+        return static_cast<std::uint8_t>(kFirstTag | (mixed >> (std::numeric_limits<std::size_t>::digits - 7)));
+    }
+
+    static std::size_t RoundUp(const std::size_t num_buckets) {
+        std::size_t result = kMinSlots;
+        while (result < num_buckets)
+            result <<= 1;
+        return result;
+    }
+
+    void Allocate(const std::size_t num_slots) {
+        draining_ = false;
+        control_.assign(num_slots, kEmpty);
+        slots_.assign(num_slots, T());
+        mask_ = num_slots - 1;
+        size_ = 0;
+        tombstones_ = 0;
+    }
+
+    BUCKETS_OPTIMISTIC_READ std::size_t Find(const T& element, const std::size_t mixed) const {
+        const std::uint8_t tag = Tag(mixed);
+        std::size_t index = mixed & mask_;
+        std::size_t probes = 0;
+#if defined(__SSE2__)
+        // Whole groups while they do not wrap around the end of the table;
+        // the scalar loop below takes over from there.
+        const __m128i tags = _mm_set1_epi8(static_cast<char>(tag));
+        const __m128i empty = _mm_setzero_si128();
+        while (index + kGroupSize <= control_.size() && probes <= mask_) {
+            const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&control_[index]));
+            const unsigned empties = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, empty)));
+            // Only tags before the first empty slot belong to the probe run.
+            const unsigned before_empty = empties ? (empties & -empties) - 1 : 0xFFFFu;
+            for (unsigned matches = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, tags))) & before_empty;
+                 matches; matches &= matches - 1) {
+                const std::size_t slot = index + __builtin_ctz(matches);
+                if (slots_[slot] == element)
+                    return slot;
+            }
+            if (empties)
+                return kNotFound;
+            index = (index + kGroupSize) & mask_;
+            probes += kGroupSize;
+        }
+#endif
+        // Bounded so that an optimistic reader racing a writer terminates.
+        for (; probes <= mask_; probes++, index = (index + 1) & mask_) {
+            if (control_[index] == kEmpty)
+                return kNotFound;
+            if (control_[index] == tag && slots_[index] == element)
+                return index;
+        }
+        return kNotFound;
+    }
+
+    Hash hash_;
+    std::vector<std::uint8_t> control_;
+    std::vector<T> slots_;
+    std::size_t mask_;
+    std::size_t size_;
+    std::size_t tombstones_;
+    bool draining_;
+};
+
+#endif /* Buckets_h */
@@ -11,115 +11,127 @@
 
 #include <algorithm>
 #include <atomic>
-#include <condition_variable>
-#include <forward_list>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
-class ReadWriteLock {
-public:
-    ReadWriteLock() {
-        writers_.store(0);
-        readers_.store(0);
-        write_state.store(false);
-    }
-    
-    void ReadLock() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        read_cv_.wait(lock, [this](){ return !writers_.load(); });
-        readers_.fetch_add(1);
-    }
-    
-    void ReadUnlock() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        readers_.fetch_sub(1);
-        if (readers_.load() == 0)
-            write_cv_.notify_one();
-    }
-    
-    void WriteLock() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        writers_.fetch_add(1);
-        write_cv_.wait(lock, [this](){ return readers_.load() == 0 && !write_state; });
-        write_state.store(true);
-    }
-    
-    void WriteUnlock() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        writers_.fetch_sub(1);
-        write_state.store(false);
-        write_cv_.notify_one();
-        read_cv_.notify_all();
-    }
-    
-private:
-    std::atomic<size_t> writers_;
-    std::atomic<size_t> readers_;
-    std::atomic<bool> write_state;
-    
-    std::condition_variable read_cv_;
-    std::condition_variable write_cv_;
+#include "Buckets.h"
+#include "../Cache Line/CacheLine.h"
+#include "../Lock Free Hash Set/SplitOrderedHashSet.h"
+#include "../Read Write Lock/ReadWriteLock.h"
+#include "../Stats/Stats.h"
+
+// StripedHashSet::GetStats(). Lock and rehash counters are only kept
+// with CONCURRENCY_STATS and read zero otherwise; the occupancy fields
+// are always filled in, one stripe at a time under its read lock.
+struct StripedHashSetStats {
+    struct StripeStats {
+        std::uint64_t lock_acquisitions = 0;    // Insert/Remove/locked Contains
+        std::uint64_t lock_wait_ns = 0;
+        std::size_t size = 0;
+        std::size_t bucket_count = 0;
+    };
     
-    std::mutex mutex_;
+    std::vector<StripeStats> stripes;
+    std::uint64_t rehashes = 0;
+    std::uint64_t rehash_ns = 0;                // migration work done inside Insert/Remove
+    std::vector<std::size_t> chain_lengths;     // see Buckets::ChainLengths
+    double load_factor = 0;
 };
 
-template <typename T, class Hash = std::hash<T>>
+// Buckets picks how each stripe stores its elements (see Buckets.h):
+// ChainedBuckets keeps the classic forward_list chains,
+// PooledChainedBuckets the same with nodes recycled through an
+// ObjectPool, OpenAddressingBuckets a flat probe table for small
+// trivially copyable keys. Each stripe owns its own table, so probing never leaves the
+// stripe whose lock is held.
+//
+// Stripes also grow on their own. When a stripe goes over the load
+// factor, its table becomes the "old" one and a table growth_factor
+// times larger takes its place; every later Insert/Remove on that stripe
+// then moves kMigrationStep old buckets across. Lookups check the new
+// table first and the old one while it is still draining, so no
+// operation ever waits for more than a few buckets' worth of rehashing.
+//
+// Every stripe carries a seqlock-style version that writers make odd for
+// the duration of a change. With a policy that allows optimistic reads,
+// Contains snapshots the version, searches without locking and retries
+// if it moved; it falls back to the read lock after kOptimisticAttempts.
+// Lock is the per-stripe reader-writer lock (see ReadWriteLock.h).
+// Tables such a reader may still be looking at are retired rather than
+// freed; since they only ever grow, they add up to less than the live one.
+//
+// For loading many keys at once, Reserve() sizes every stripe up front,
+// InsertBulk() sorts a batch by stripe and takes each lock once, and
+// InsertParallel() does the same on a ThreadPool, one worker per stripe
+// at a time. A stripe being filled keeps its version odd for the whole
+// run, so concurrent Contains calls on it wait on the lock meanwhile.
+//
+// ContainsBatch() answers a whole batch of lookups with one snapshot or
+// lock per stripe touched, prefetching buckets a few keys ahead.
+//
+// GetStats() shows whether concurrency_level fits the load: lock waits
+// per stripe point at contention, and stripe sizes that differ a lot
+// point at a hash that piles elements into a few stripes.
+template <typename T, class Hash = std::hash<T>, template <class, class> class Buckets = ChainedBuckets, class Lock = AdaptiveReadWriteLock>
 class StripedHashSet {
 public:
     explicit StripedHashSet(const size_t concurrency_level,
                             const size_t growth_factor = 2,
                             const double load_factor = 1.25):
-    growth_factor_(growth_factor),
-    max_load_factor_(load_factor),
+    growth_factor_(std::max<std::size_t>(growth_factor, 2)),
+    max_load_factor_(std::min(load_factor, Buckets<T, Hash>::kMaxLoadFactor)),
     num_stripes_(concurrency_level),
-    locks_(concurrency_level) {
-        
-        num_elements_.store(0);
-        hash_table_.resize(concurrency_level);
-    }
+    hash_table_(new Stripe[concurrency_level]),
+    lock_counters_(kStatsEnabled ? new LockCounters[concurrency_level] : nullptr) {}
     
     bool Insert(const T& element) {
         const size_t hash_value = hash(element);
         
         std::size_t stripe_index = GetStripeIndex(hash_value);
-        locks_[stripe_index].WriteLock();
+        WriteLockStripe(stripe_index);
         
-        std::size_t bucket_index = GetBucketIndex(hash_value);
-        auto it = std::find(hash_table_[bucket_index].begin(), hash_table_[bucket_index].end(), element);
-        
-        if (it != hash_table_[bucket_index].end()) {
-            locks_[stripe_index].WriteUnlock();
+        Stripe& stripe = hash_table_[stripe_index];
+        if (stripe.Contains(element, hash_value)) {
+            hash_table_[stripe_index].lock.WriteUnlock();
             return false;
         }
-        if (GetLoadFactor() > max_load_factor_) {
-            locks_[stripe_index].WriteUnlock();
-            Rehash();
-            return Insert(element);
-        } else {
-            hash_table_[bucket_index].push_front(element);
-            num_elements_.fetch_add(1);
-            locks_[stripe_index].WriteUnlock();
-            return true;
-        }
+        
+        stripe.BeginWrite();
+        MigrateStep(stripe);
+        if (stripe.Size() + 1 > max_load_factor_ * stripe.Table().BucketCount())
+            StartMigration(stripe);
+        stripe.Table().Insert(element, hash_value);
+        stripe.EndWrite();
+        
+        stripe.Count(1);
+        hash_table_[stripe_index].lock.WriteUnlock();
+        return true;
     }
     
     bool Remove(const T& element) {
         const size_t hash_value = hash(element);
         
         std::size_t stripe_index = GetStripeIndex(hash_value);
-        locks_[stripe_index].WriteLock();
+        WriteLockStripe(stripe_index);
         
-        std::size_t bucket_index = GetBucketIndex(hash_value);
-        auto it = std::find(hash_table_[bucket_index].begin(), hash_table_[bucket_index].end(), element);
+        Stripe& stripe = hash_table_[stripe_index];
+        stripe.BeginWrite();
+        MigrateStep(stripe);
+        const bool removed = stripe.Remove(element, hash_value);
+        stripe.EndWrite();
         
-        if (it == hash_table_[bucket_index].end()) {
-            locks_[stripe_index].WriteUnlock();
+        if (!removed) {
+            hash_table_[stripe_index].lock.WriteUnlock();
             return false;
         }
         
-        hash_table_[bucket_index].remove(*it);
-        num_elements_.fetch_sub(1);
-        locks_[stripe_index].WriteUnlock();
+        stripe.Count(-1);
+        hash_table_[stripe_index].lock.WriteUnlock();
         
         return true;
     }
@@ -128,56 +140,401 @@ public:
         const size_t hash_value = hash(element);
         
         std::size_t stripe_index = GetStripeIndex(hash_value);
-        locks_[stripe_index].ReadLock();
+        Stripe& stripe = hash_table_[stripe_index];
         
-        std::size_t bucket_index = GetBucketIndex(hash_value);
-        bool found = std::find(hash_table_[bucket_index].begin(), hash_table_[bucket_index].end(), element) != hash_table_[bucket_index].end();
-        locks_[stripe_index].ReadUnlock();
+        if (Buckets<T, Hash>::kOptimisticReads) {
+            for (std::size_t attempt = 0; attempt < kOptimisticAttempts; attempt++) {
+                const std::size_t version = stripe.version.load(std::memory_order_acquire);
+                if (version & 1)
+                    continue;
+                const bool found = stripe.Contains(element, hash_value);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (stripe.version.load(std::memory_order_relaxed) == version)
+                    return found;
+            }
+        }
+        
+        ReadLockStripe(stripe_index);
+        
+        bool found = stripe.Contains(element, hash_value);
+        hash_table_[stripe_index].lock.ReadUnlock();
         
         return found;
     }
     
+    // Sets bit i of out_bits (count bits, rounded up to whole words) to
+    // Contains(keys[i]). Keys are hashed up front and looked up stripe by
+    // stripe, one optimistic snapshot or read lock per stripe, with the
+    // buckets of later keys prefetched while earlier ones are probed.
+    void ContainsBatch(const T* keys, const std::size_t count, std::uint64_t* out_bits) {
+        std::fill(out_bits, out_bits + (count + 63) / 64, 0);
+        
+        // Counting sort by stripe.
+        std::vector<std::size_t> stripe_begin(num_stripes_ + 1, 0);
+        std::vector<std::size_t> hashes(count);
+        for (std::size_t i = 0; i < count; i++) {
+            hashes[i] = hash(keys[i]);
+            stripe_begin[GetStripeIndex(hashes[i]) + 1]++;
+        }
+        for (std::size_t i = 0; i < num_stripes_; i++)
+            stripe_begin[i + 1] += stripe_begin[i];
+        std::vector<Probe> probes(count);
+        for (std::size_t i = 0; i < count; i++)
+            probes[stripe_begin[GetStripeIndex(hashes[i])]++] = Probe{hashes[i], i};
+        
+        // stripe_begin[s] is now where stripe s + 1 begins.
+        for (std::size_t stripe_index = 0, first = 0; first < count; first = stripe_begin[stripe_index++]) {
+            const std::size_t last = stripe_begin[stripe_index];
+            if (first == last)
+                continue;
+            
+            Stripe& stripe = hash_table_[stripe_index];
+            bool done = false;
+            if (Buckets<T, Hash>::kOptimisticReads) {
+                for (std::size_t attempt = 0; attempt < kOptimisticAttempts && !done; attempt++) {
+                    const std::size_t version = stripe.version.load(std::memory_order_acquire);
+                    if (version & 1)
+                        continue;
+                    LookupRun(stripe, keys, probes.data() + first, probes.data() + last, out_bits);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    done = stripe.version.load(std::memory_order_relaxed) == version;
+                }
+            }
+            if (!done) {
+                ReadLockStripe(stripe_index);
+                LookupRun(stripe, keys, probes.data() + first, probes.data() + last, out_bits);
+                hash_table_[stripe_index].lock.ReadUnlock();
+            }
+        }
+    }
+    
+    // Sums the stripes' counts, so it costs a pass over them but keeps
+    // Insert/Remove off any shared counter. Not atomic across stripes.
     size_t Size() {
-        return num_elements_.load();
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < num_stripes_; i++)
+            total += hash_table_[i].Size();
+        return total;
     }
     
-private:
+    // Grows every stripe so that num_elements spread evenly over them fit
+    // without rehashing.
+    void Reserve(const std::size_t num_elements) {
+        const std::size_t per_stripe = (num_elements + num_stripes_ - 1) / num_stripes_;
+        for (std::size_t i = 0; i < num_stripes_; i++) {
+            WriteLockStripe(i);
+            Stripe& stripe = hash_table_[i];
+            stripe.BeginWrite();
+            GrowStripe(stripe, per_stripe);
+            stripe.EndWrite();
+            hash_table_[i].lock.WriteUnlock();
+        }
+    }
     
-    void Rehash() {
+    // Inserts [first, last) and returns how many elements were new.
+    template <class ForwardIt>
+    std::size_t InsertBulk(ForwardIt first, ForwardIt last) {
+        std::vector<const T*> elements;
+        std::vector<std::size_t> hashes;
+        for (; first != last; ++first) {
+            elements.push_back(&*first);
+            hashes.push_back(hash(*first));
+        }
         
-        for (std::size_t i = 0; i < num_stripes_; i++) {
-            locks_[i].WriteLock();
+        std::vector<std::size_t> order(elements.size());
+        std::vector<std::size_t> stripe_begin(num_stripes_ + 1, 0);
+        for (std::size_t hash_value : hashes)
+            stripe_begin[GetStripeIndex(hash_value) + 1]++;
+        for (std::size_t i = 0; i < num_stripes_; i++)
+            stripe_begin[i + 1] += stripe_begin[i];
+        std::vector<std::size_t> next(stripe_begin.begin(), stripe_begin.end() - 1);
+        for (std::size_t i = 0; i < hashes.size(); i++)
+            order[next[GetStripeIndex(hashes[i])]++] = i;
+        
+        std::size_t inserted = 0;
+        for (std::size_t i = 0; i < num_stripes_; i++)
+            inserted += InsertRun(i, order.data() + stripe_begin[i], order.data() + stripe_begin[i + 1],
+                                  [&](const std::size_t index) -> const T& { return *elements[index]; }, hashes);
+        return inserted;
+    }
+    
+    // InsertBulk on pool (a ThreadPool): hashes and sorts the keys by
+    // stripe in parallel, then fills the stripes in parallel, so no two
+    // workers ever wait for the same lock.
+    template <class RandomIt, class Pool>
+    std::size_t InsertParallel(RandomIt first, RandomIt last, Pool& pool) {
+        const std::size_t count = static_cast<std::size_t>(last - first);
+        if (!count)
+            return 0;
+        
+        const std::size_t num_chunks = std::min(count, kBuildChunks);
+        const std::size_t chunk = (count + num_chunks - 1) / num_chunks;
+        std::vector<std::size_t> hashes(count);
+        std::vector<std::size_t> counts(num_chunks * num_stripes_, 0);
+        pool.ParallelFor(std::size_t(0), num_chunks, 1, [&](const std::size_t c){
+            for (std::size_t i = c * chunk; i < std::min(count, (c + 1) * chunk); i++) {
+                hashes[i] = hash(first[i]);
+                counts[c * num_stripes_ + GetStripeIndex(hashes[i])]++;
+            }
+        });
+        
+        // counts[c][s] becomes where chunk c's keys of stripe s go.
+        std::vector<std::size_t> stripe_begin(num_stripes_ + 1, 0);
+        std::size_t offset = 0;
+        for (std::size_t s = 0; s < num_stripes_; s++) {
+            stripe_begin[s] = offset;
+            for (std::size_t c = 0; c < num_chunks; c++) {
+                const std::size_t keys = counts[c * num_stripes_ + s];
+                counts[c * num_stripes_ + s] = offset;
+                offset += keys;
+            }
         }
+        stripe_begin[num_stripes_] = offset;
+        
+        std::vector<std::size_t> order(count);
+        pool.ParallelFor(std::size_t(0), num_chunks, 1, [&](const std::size_t c){
+            for (std::size_t i = c * chunk; i < std::min(count, (c + 1) * chunk); i++)
+                order[counts[c * num_stripes_ + GetStripeIndex(hashes[i])]++] = i;
+        });
+        
+        std::atomic<std::size_t> inserted(0);
+        pool.ParallelFor(std::size_t(0), num_stripes_, 1, [&](const std::size_t s){
+            inserted.fetch_add(InsertRun(s, order.data() + stripe_begin[s], order.data() + stripe_begin[s + 1],
+                                         [&](const std::size_t index) -> const T& { return first[index]; }, hashes),
+                               std::memory_order_relaxed);
+        });
+        return inserted.load();
+    }
+    
+    StripedHashSetStats GetStats() {
+        StripedHashSetStats result;
+        result.stripes.resize(num_stripes_);
+        result.rehashes = rehashes_.Load();
+        result.rehash_ns = rehash_ns_.Load();
         
-        if (GetLoadFactor() <= max_load_factor_) {
-            for (std::size_t i = 0; i < num_stripes_; i++) {
-                locks_[i].WriteUnlock();
+        std::size_t total_buckets = 0;
+        for (std::size_t i = 0; i < num_stripes_; i++) {
+            StripedHashSetStats::StripeStats& current = result.stripes[i];
+            if constexpr (kStatsEnabled) {
+                current.lock_acquisitions = lock_counters_[i].acquisitions.load(std::memory_order_relaxed);
+                current.lock_wait_ns = lock_counters_[i].wait_ns.load(std::memory_order_relaxed);
             }
+            
+            hash_table_[i].lock.ReadLock();
+            Stripe& stripe = hash_table_[i];
+            const Buckets<T, Hash>* old = stripe.old_table.load(std::memory_order_relaxed);
+            current.size = stripe.Size();
+            current.bucket_count = stripe.Table().BucketCount() + (old ? old->BucketCount() : 0);
+            stripe.Table().ChainLengths(result.chain_lengths);
+            if (old)
+                old->ChainLengths(result.chain_lengths);
+            hash_table_[i].lock.ReadUnlock();
+            
+            total_buckets += current.bucket_count;
+        }
+        result.load_factor = total_buckets ? static_cast<double>(Size()) / total_buckets : 0.0;
+        return result;
+    }
+    
+private:
+    
+    static constexpr std::size_t kMigrationStep = 8;
+    static constexpr std::size_t kOptimisticAttempts = 4;
+    static constexpr std::size_t kBuildChunks = 256;
+    static constexpr std::size_t kPrefetchDistance = 8;
+    
+    // A stripe's lock and everything it guards share the stripe's own
+    // cache lines, so writers to neighbouring stripes never collide.
+    struct alignas(kCacheLineSize) Stripe {
+        Stripe(): table(new Buckets<T, Hash>(1, Hash())), old_table(nullptr) {}
+        
+        Stripe(const Stripe& other) = delete;
+        Stripe& operator=(const Stripe& other) = delete;
+        
+        ~Stripe() {
+            delete table.load();
+            delete old_table.load();
+        }
+        
+        Buckets<T, Hash>& Table() {
+            return *table.load(std::memory_order_relaxed);
+        }
+        
+        bool Contains(const T& element, const std::size_t hash_value) const {
+            const Buckets<T, Hash>* old = old_table.load(std::memory_order_acquire);
+            return table.load(std::memory_order_acquire)->Contains(element, hash_value) ||
+                   (old && old->Contains(element, hash_value));
+        }
+        
+        bool Remove(const T& element, const std::size_t hash_value) {
+            Buckets<T, Hash>* old = old_table.load(std::memory_order_relaxed);
+            return Table().Remove(element, hash_value) ||
+                   (old && old->Remove(element, hash_value));
+        }
+        
+        void BeginWrite() {
+            version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        
+        void EndWrite() {
+            version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        
+        void Retire(Buckets<T, Hash>* buckets) {
+            if (Buckets<T, Hash>::kOptimisticReads)
+                retired.emplace_back(buckets);
+            else
+                delete buckets;
+        }
+        
+        std::size_t Size() const {
+            return size.load(std::memory_order_relaxed);
+        }
+        
+        // Under the write lock only; Size() may read it without one.
+        void Count(const std::ptrdiff_t delta) {
+            size.store(size.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+        }
+        
+        Lock lock;
+        std::atomic<size_t> version{0};
+        std::atomic<Buckets<T, Hash>*> table;
+        std::atomic<Buckets<T, Hash>*> old_table;   // non-null while rehashing
+        std::size_t migrated = 0;                   // old buckets already moved
+        std::atomic<std::size_t> size{0};
+        std::vector<std::unique_ptr<Buckets<T, Hash>>> retired;
+    };
+    
+    void MigrateStep(Stripe& stripe, const std::size_t max_buckets = kMigrationStep) {
+        Buckets<T, Hash>* old = stripe.old_table.load(std::memory_order_relaxed);
+        if (!old)
             return;
+        
+        const std::uint64_t started = StatsNow();
+        const std::size_t last = std::min(stripe.migrated + max_buckets, old->BucketCount());
+        old->MigrateBuckets(stripe.migrated, last, stripe.Table());
+        stripe.migrated = last;
+        if (stripe.migrated == old->BucketCount()) {
+            stripe.old_table.store(nullptr, std::memory_order_release);
+            stripe.Retire(old);
         }
+        rehash_ns_.Add(StatsNow() - started);
+    }
+    
+    void StartMigration(Stripe& stripe) {
+        // Only reached if a stripe outgrows its new table before the old
+        // one has drained, which takes a burst far larger than the step.
+        MigrateStep(stripe, std::numeric_limits<std::size_t>::max());
+        rehashes_.Add();
         
-        const size_t new_size = hash_table_.size() * growth_factor_;
-        std::vector<std::forward_list<T>> temp(new_size);
-        for (auto const &bucket : hash_table_) {
-            for (auto const &item : bucket) {
-                const size_t hash_value = hash(item);
-                const size_t bucket_index = hash_value % new_size;
-                temp[bucket_index].push_front(std::move(item));
-            }
+        const std::size_t new_size = stripe.Table().BucketCount() * growth_factor_;
+        stripe.old_table.store(&stripe.Table(), std::memory_order_release);
+        stripe.table.store(new Buckets<T, Hash>(new_size, Hash()), std::memory_order_release);
+        stripe.migrated = 0;
+    }
+    
+    struct Probe {
+        std::size_t hash_value;
+        std::size_t index;          // into the keys of ContainsBatch
+    };
+    
+    // ContainsBatch for the probes [begin, end), all in stripe. Every bit
+    // is written, set or cleared, so a retry overwrites the results of an
+    // attempt that raced a writer.
+    void LookupRun(const Stripe& stripe, const T* keys, const Probe* begin, const Probe* end, std::uint64_t* out_bits) const {
+        const Buckets<T, Hash>* table = stripe.table.load(std::memory_order_acquire);
+        for (const Probe* it = begin; it != end && it != begin + kPrefetchDistance; ++it)
+            table->Prefetch(it->hash_value);
+        
+        for (const Probe* it = begin; it != end; ++it) {
+            if (end - it > static_cast<std::ptrdiff_t>(kPrefetchDistance))
+                table->Prefetch(it[kPrefetchDistance].hash_value);
+            const std::uint64_t bit = std::uint64_t(1) << (it->index % 64);
+            if (stripe.Contains(keys[it->index], it->hash_value))
+                out_bits[it->index / 64] |= bit;
+            else
+                out_bits[it->index / 64] &= ~bit;
         }
-        hash_table_ = std::move(temp);
+    }
+    
+    // Replaces the stripe's table with one that holds num_elements
+    // within the load factor, moving everything over at once, unless it
+    // is big enough already. An unfinished migration is finished either
+    // way. Called with the stripe locked and mid-write.
+    void GrowStripe(Stripe& stripe, const std::size_t num_elements) {
+        MigrateStep(stripe, std::numeric_limits<std::size_t>::max());
+        const std::size_t num_buckets = static_cast<std::size_t>(num_elements / max_load_factor_) + 1;
+        if (stripe.Table().BucketCount() >= num_buckets)
+            return;
         
-        for (std::size_t i = 0; i < num_stripes_; i++) {
-            locks_[i].WriteUnlock();
+        const std::uint64_t started = StatsNow();
+        rehashes_.Add();
+        Buckets<T, Hash>* old = &stripe.Table();
+        Buckets<T, Hash>* fresh = new Buckets<T, Hash>(num_buckets, Hash());
+        old->MigrateBuckets(0, old->BucketCount(), *fresh);
+        stripe.table.store(fresh, std::memory_order_release);
+        stripe.Retire(old);
+        rehash_ns_.Add(StatsNow() - started);
+    }
+    
+    // Inserts element(order[i]) with hash hashes[order[i]] for every i in
+    // [begin, end), all of which fall into stripe_index, under one lock.
+    template <class Element>
+    std::size_t InsertRun(const std::size_t stripe_index, const std::size_t* begin, const std::size_t* end,
+                          const Element& element, const std::vector<std::size_t>& hashes) {
+        if (begin == end)
+            return 0;
+        
+        WriteLockStripe(stripe_index);
+        Stripe& stripe = hash_table_[stripe_index];
+        stripe.BeginWrite();
+        GrowStripe(stripe, stripe.Size() + (end - begin));
+        
+        std::size_t inserted = 0;
+        for (const std::size_t* it = begin; it != end; ++it) {
+            const T& current = element(*it);
+            const std::size_t hash_value = hashes[*it];
+            if (stripe.Table().Contains(current, hash_value))
+                continue;
+            stripe.Table().Insert(current, hash_value);
+            inserted++;
         }
+        stripe.EndWrite();
+        
+        stripe.Count(static_cast<std::ptrdiff_t>(inserted));
+        hash_table_[stripe_index].lock.WriteUnlock();
+        return inserted;
     }
     
-    std::size_t GetLoadFactor() const {
-        return static_cast<double>(num_elements_.load()) / hash_table_.size();
+    struct alignas(kCacheLineSize) LockCounters {
+        std::atomic<std::uint64_t> acquisitions{0};
+        std::atomic<std::uint64_t> wait_ns{0};
+        
+        void Record(const std::uint64_t ns) {
+            acquisitions.fetch_add(1, std::memory_order_relaxed);
+            wait_ns.fetch_add(ns, std::memory_order_relaxed);
+        }
+    };
+    
+    void WriteLockStripe(const std::size_t stripe_index) {
+        if constexpr (kStatsEnabled) {
+            const std::uint64_t started = StatsNow();
+            hash_table_[stripe_index].lock.WriteLock();
+            lock_counters_[stripe_index].Record(StatsNow() - started);
+        } else {
+            hash_table_[stripe_index].lock.WriteLock();
+        }
     }
     
-    std::size_t GetBucketIndex(const std::size_t element_hash_value) const {
-        return element_hash_value % hash_table_.size();
+    void ReadLockStripe(const std::size_t stripe_index) {
+        if constexpr (kStatsEnabled) {
+            const std::uint64_t started = StatsNow();
+            hash_table_[stripe_index].lock.ReadLock();
+            lock_counters_[stripe_index].Record(StatsNow() - started);
+        } else {
+            hash_table_[stripe_index].lock.ReadLock();
+        }
     }
     
     std::size_t GetStripeIndex(const std::size_t element_hash_value) const {
@@ -185,17 +542,27 @@ private:
     }
     
     std::size_t growth_factor_;
-    std::size_t max_load_factor_;
+    double max_load_factor_;
     
-    std::atomic<size_t> num_elements_;
     const std::size_t num_stripes_;
+    std::unique_ptr<Stripe[]> hash_table_;
     
-    std::vector<ReadWriteLock> locks_;
-    std::vector<std::forward_list<T>> hash_table_;
+    std::unique_ptr<LockCounters[]> lock_counters_;     // CONCURRENCY_STATS only
+    ShardedCounter rehashes_;
+    ShardedCounter rehash_ns_;
     
     Hash hash;
 };
 
-template <typename T> using ConcurrentSet = StripedHashSet<T>;
+// Striped locks suit write-heavy sets of roughly known size; the
+// lock-free split-ordered set has no concurrency_level to outgrow and
+// never blocks a reader, at the price of a list walk per lookup.
+enum class SetKind {
+    Striped,
+    LockFree
+};
+
+template <typename T, SetKind kind = SetKind::Striped>
+using ConcurrentSet = typename std::conditional<kind == SetKind::Striped, StripedHashSet<T>, SplitOrderedHashSet<T>>::type;
 
 #endif /* StripedHashSet_h */
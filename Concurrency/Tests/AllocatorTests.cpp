@@ -0,0 +1,285 @@
+//
+//  AllocatorTests.cpp
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../Blocking Queue/BlockingQueue.h"
+#include "../Optimistic Linked List/numa_arena_allocator.h"
+#include "../Optimistic Linked List/object_pool.h"
+#include "../Optimistic Linked List/optimistic_linked_set.h"
+#include "Testing.h"
+
+TEST(allocator_arena_chunks) {
+    ArenaAllocator fixed(1024);
+    bool threw = false;
+    try {
+        for (int i = 0; i < 1000; i++)
+            fixed.New<long>(i);
+    } catch (std::bad_alloc&) {
+        threw = true;
+    }
+    CHECK(threw);
+
+    ArenaAllocator growable(4096, true);
+    const int per_thread = static_cast<int>(Scale(20000));
+    RunThreads(4, [&](std::size_t){
+        for (int i = 0; i < per_thread; i++) {
+            long* value = growable.New<long>(i);
+            CHECK(*value == i && reinterpret_cast<std::uintptr_t>(value) % alignof(long) == 0);
+        }
+    });
+    CHECK(growable.SpaceUsed() >= 4 * per_thread * sizeof(long));
+    growable.Reset();
+    CHECK(growable.SpaceUsed() == 0 && growable.SpaceReserved() == 4096);
+}
+
+TEST(allocator_arena_slabs) {
+    ArenaAllocator arena(1 << 20, true, ArenaAllocator::kDefaultSlabSize);
+    ArenaAllocator other(1 << 16, true, 4096);
+    RunThreads(4, [&](std::size_t){
+        for (std::size_t i = 0; i < Scale(20000); i++) {
+            long* value = arena.New<long>(static_cast<long>(i));
+            double* other_value = other.New<double>(static_cast<double>(i));
+            CHECK(*value == static_cast<long>(i) && *other_value == static_cast<double>(i));
+        }
+    });
+    arena.Reset();
+    CHECK(*arena.New<long>(3) == 3);
+    OptimisticLinkedSet<int> set(arena);
+    for (int i = 0; i < 10000; i++)
+        set.Insert(i);
+    CHECK(set.Size() == 10000);
+}
+
+TEST(allocator_arena_slabs_many_arenas) {
+    // Arenas created one after another get consecutive ids, so the first
+    // and the ninth would share a slot in a table of eight. Alternating
+    // between them must not make either carve a new slab every time.
+    std::vector<std::unique_ptr<ArenaAllocator>> arenas;
+    for (int i = 0; i < 9; i++)
+        arenas.push_back(std::make_unique<ArenaAllocator>(1 << 20, true, ArenaAllocator::kDefaultSlabSize));
+    ArenaAllocator& first = *arenas.front();
+    ArenaAllocator& last = *arenas.back();
+    for (int i = 0; i < 1000; i++) {
+        CHECK(*first.New<long>(i) == i);
+        CHECK(*last.New<long>(i) == i);
+    }
+    CHECK(first.SpaceUsed() <= 2 * ArenaAllocator::kDefaultSlabSize);
+    CHECK(last.SpaceUsed() <= 2 * ArenaAllocator::kDefaultSlabSize);
+}
+
+TEST(allocator_optimistic_linked_set) {
+    ArenaAllocator arena(1 << 20, true, ArenaAllocator::kDefaultSlabSize);
+    OptimisticLinkedSet<int> set(arena);
+    CHECK(set.Insert(5) && !set.Insert(5) && set.Contains(5) && set.Remove(5) && !set.Contains(5) && !set.Remove(5));
+    std::atomic<long> net(0);
+    RunThreads(4, [&](std::size_t thread){
+        std::mt19937 random(static_cast<unsigned>(thread));
+        for (std::size_t i = 0; i < Scale(40000); i++) {
+            const int key = static_cast<int>(random() % 128);
+            if (random() & 1) {
+                if (set.Insert(key))
+                    net++;
+            } else if (set.Remove(key)) {
+                net--;
+            }
+            set.Contains(key ^ 1);
+        }
+    });
+    CHECK(static_cast<long>(set.Size()) == net);
+    long present = 0;
+    for (int key = 0; key < 128; key++)
+        present += set.Contains(key);
+    CHECK(present == net);
+}
+
+TEST(allocator_arena_cross_thread_recycling) {
+    // One thread inserts, another removes: nodes are reclaimed on the wrong
+    // thread, yet the arena levels off at a bounded footprint.
+    ArenaAllocator arena(4096, true);
+    OptimisticLinkedSet<int> set(arena);
+    const std::size_t rounds = Scale(4000);
+    std::atomic<std::size_t> turn(0);
+    std::atomic<std::size_t> reserved(0);
+    RunThreads(2, [&](std::size_t thread){
+        for (std::size_t round = 0; round < rounds; round++) {
+            while (turn.load() != 2 * round + thread)
+                std::this_thread::yield();
+            for (int key = 0; key < 64; key++)
+                CHECK(thread == 0 ? set.Insert(key) : set.Remove(key));
+            if (thread == 1 && round == rounds / 10)
+                reserved = arena.SpaceReserved();
+            turn++;
+        }
+    });
+    CHECK(arena.SpaceReserved() <= reserved + 4 * 4096);
+
+    // Recycled blocks serve every request of their size class.
+    ArenaAllocator mixed(1 << 16);
+    struct Small { char bytes[20]; };
+    struct Large { char bytes[32]; };
+    void* small = mixed.Allocate<Small>();
+    mixed.Recycle(small, sizeof(Small));
+    unsigned char* large = static_cast<unsigned char*>(mixed.Allocate<Large>());
+    CHECK(large == small);
+    CHECK(static_cast<unsigned char*>(mixed.Allocate<Large>()) >= large + sizeof(Large));
+}
+
+static void DeleteInt(void* object, void* context) {
+    delete static_cast<int*>(object);
+    ++*static_cast<int*>(context);
+}
+
+TEST(allocator_epoch_reclamation) {
+    EpochDomain domain;
+    int freed = 0;
+    {
+        EpochGuard outer(domain);
+        EpochGuard inner(domain);
+    }
+    for (int i = 0; i < 1000; i++)
+        domain.Retire(new int(i), DeleteInt, &freed);
+    CHECK(freed > 800);
+    CHECK(freed + static_cast<int>(domain.PendingCount()) == 1000);
+
+    // PendingCount may be polled while other threads retire.
+    std::atomic<int> reclaimed(0);
+    std::atomic<bool> retiring(true);
+    const int per_thread = static_cast<int>(Scale(20000));
+    RunThreads(3, [&](std::size_t thread){
+        if (thread == 0) {
+            while (retiring)
+                CHECK(domain.PendingCount() <= 1000 + 2 * static_cast<std::size_t>(per_thread));
+            return;
+        }
+        for (int i = 0; i < per_thread; i++)
+            domain.Retire(new int(i), [](void* object, void* context){
+                delete static_cast<int*>(object);
+                ++*static_cast<std::atomic<int>*>(context);
+            }, &reclaimed);
+        if (thread == 1)
+            retiring = false;
+    });
+}
+
+struct Named {
+    std::string name;
+    long value;
+
+    explicit Named(const long value): name(std::to_string(value) + std::string(30, 'x')), value(value) {}
+};
+
+TEST(allocator_object_pool) {
+    {
+        ObjectPool<Named> pool(true);
+        // Allocated on one thread, freed on another.
+        BlockingQueue<Named*> queue(64);
+        const long count = static_cast<long>(Scale(200000));
+        std::thread producer([&](){
+            for (long i = 0; i < count; i++)
+                queue.Put(pool.New(i));
+            queue.Shutdown();
+        });
+        long sum = 0;
+        Named* object;
+        while (queue.Get(object)) {
+            CHECK(object->name == std::to_string(object->value) + std::string(30, 'x'));
+            sum += object->value;
+            pool.Delete(object);
+        }
+        producer.join();
+        CHECK(sum == count * (count - 1) / 2);
+
+        RunThreads(4, [&](std::size_t){
+            std::vector<Named*> live;
+            for (std::size_t round = 0; round < Scale(200); round++) {
+                for (int i = 0; i < 100; i++)
+                    live.push_back(pool.New(i));
+                for (Named* named : live)
+                    pool.Delete(named);
+                live.clear();
+            }
+        });
+    }
+
+    {
+        // The pool goes away while another thread still caches blocks.
+        ObjectPool<Named>* pool = new ObjectPool<Named>();
+        std::atomic<bool> used(false);
+        std::atomic<bool> deleted(false);
+        std::thread user([&](){
+            pool->Delete(pool->New(1));
+            used = true;
+            while (!deleted)
+                std::this_thread::yield();
+        });
+        while (!used)
+            std::this_thread::yield();
+        delete pool;
+        deleted = true;
+        user.join();
+    }
+
+    {
+        struct Throws {
+            Throws() { throw 1; }
+        };
+        ArenaAllocator arena(1 << 20, true);
+        ObjectPool<Throws> throwing(arena);
+        bool threw = false;
+        try {
+            throwing.New();
+        } catch (int) {
+            threw = true;
+        }
+        CHECK(threw);
+        ObjectPool<Named> pool(arena);
+        Named* named = pool.New(5);
+        CHECK(named->value == 5);
+        pool.Delete(named);
+    }
+}
+
+TEST(allocator_object_pool_poison) {
+    // A write after Delete must abort the child (or trip AddressSanitizer).
+    const pid_t child = fork();
+    if (child == 0) {
+        ObjectPool<Named> pool(true);
+        Named* named = pool.New(1);
+        pool.Delete(named);
+        reinterpret_cast<volatile unsigned char*>(named)[sizeof(void*) + 1] = 0;
+        pool.New(2);
+        _exit(0);
+    }
+    int status = 0;
+    CHECK(waitpid(child, &status, 0) == child);
+    CHECK(!(WIFEXITED(status) && WEXITSTATUS(status) == 0));
+}
+
+TEST(allocator_numa_arena) {
+    NumaArenaAllocator arena(1 << 16);
+    OptimisticLinkedSet<int> set(arena.LocalArena());
+    for (int i = 0; i < 1000; i++)
+        set.Insert(i);
+    CHECK(set.Size() == 1000);
+    RunThreads(4, [&](std::size_t){
+        for (int i = 0; i < 1000; i++)
+            CHECK(*arena.New<int>(i) == i);
+    });
+    CHECK(arena.SpaceUsed() >= 4000 * sizeof(int));
+}
@@ -0,0 +1,349 @@
+//
+//  HashSetTests.cpp
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Thread Pool/ThreadPool.h"
+#include "../Striped Hash Set/StripedHashSet.h"
+#include "../Optimistic Linked List/object_pool.h"
+#include "Testing.h"
+
+// Disjoint key ranges per thread: every Insert and every Remove of an
+// odd position must succeed, whatever else is rehashing meanwhile.
+template <class Set>
+static void CheckDisjointWriters(Set& set) {
+    const int per_thread = static_cast<int>(Scale(20000));
+    RunThreads(4, [&](std::size_t thread){
+        for (int i = 0; i < per_thread; i++) {
+            const int key = static_cast<int>(thread) * 1000000 + i;
+            CHECK(set.Insert(key));
+            CHECK(set.Contains(key));
+            if (i % 2)
+                CHECK(set.Remove(key));
+        }
+    });
+    CHECK(set.Size() == static_cast<std::size_t>(4 * ((per_thread + 1) / 2)));
+    for (int thread = 0; thread < 4; thread++)
+        for (int i = 0; i < per_thread; i++)
+            CHECK(set.Contains(thread * 1000000 + i) == !(i % 2));
+}
+
+// One thread against std::set.
+template <class Set>
+static void CheckAgainstReference(Set& set, const std::size_t operations, const int key_range) {
+    std::set<int> reference;
+    std::mt19937 random(1);
+    for (std::size_t i = 0; i < operations; i++) {
+        const int key = static_cast<int>(random() % key_range);
+        switch (random() % 3) {
+            case 0: CHECK(set.Insert(key) == reference.insert(key).second); break;
+            case 1: CHECK(set.Remove(key) == (reference.erase(key) == 1)); break;
+            default: CHECK(set.Contains(key) == (reference.count(key) == 1)); break;
+        }
+    }
+    CHECK(set.Size() == reference.size());
+}
+
+TEST(hash_set_striped_chained) {
+    StripedHashSet<int> set(4);
+    CHECK(set.Insert(1) && !set.Insert(1) && set.Contains(1) && set.Remove(1) && !set.Contains(1) && !set.Remove(1));
+    CheckDisjointWriters(set);
+    StripedHashSet<int> single(3);
+    CheckAgainstReference(single, Scale(400000), 50000);
+}
+
+TEST(hash_set_striped_open_addressing) {
+    StripedHashSet<int, std::hash<int>, OpenAddressingBuckets> set(4);
+    CheckDisjointWriters(set);
+    StripedHashSet<int, std::hash<int>, OpenAddressingBuckets> single(3);
+    CheckAgainstReference(single, Scale(400000), 50000);
+}
+
+TEST(hash_set_striped_pooled_chained) {
+    StripedHashSet<int, std::hash<int>, PooledChainedBuckets> set(16);
+    CheckDisjointWriters(set);
+}
+
+TEST(hash_set_striped_lock_policies) {
+    StripedHashSet<int, std::hash<int>, ChainedBuckets, ReadWriteLock> read_write(4);
+    CheckDisjointWriters(read_write);
+    StripedHashSet<int, std::hash<int>, ChainedBuckets, BigReaderLock> big_reader(4);
+    CheckDisjointWriters(big_reader);
+}
+
+template <class Lock>
+static void CheckReadWriteLock() {
+    Lock lock;
+    long counter = 0;
+    std::atomic<int> readers(0);
+    const int per_thread = static_cast<int>(Scale(20000));
+    RunThreads(4, [&](std::size_t thread){
+        for (int i = 0; i < per_thread; i++) {
+            if ((i + thread) % 4 == 0) {
+                lock.WriteLock();
+                CHECK(readers == 0);
+                counter++;
+                lock.WriteUnlock();
+            } else {
+                lock.ReadLock();
+                readers++;
+                volatile long seen = counter;
+                (void)seen;
+                readers--;
+                lock.ReadUnlock();
+            }
+        }
+    });
+    CHECK(counter == per_thread);
+}
+
+TEST(hash_set_read_write_locks) {
+    CheckReadWriteLock<ReadWriteLock>();
+    CheckReadWriteLock<AdaptiveReadWriteLock>();
+    CheckReadWriteLock<BigReaderLock>();
+}
+
+TEST(hash_set_striped_stats) {
+    StripedHashSet<int> set(8);
+    RunThreads(4, [&](std::size_t thread){
+        for (int i = 0; i < static_cast<int>(Scale(20000)); i++) {
+            set.Insert(i * 4 + static_cast<int>(thread));
+            set.Contains(i);
+            if (i % 3 == 0)
+                set.Remove(i * 4 + static_cast<int>(thread));
+        }
+    });
+    const auto stats = set.GetStats();
+    std::size_t size = 0;
+    for (const auto& stripe : stats.stripes)
+        size += stripe.size;
+    CHECK(size == set.Size());
+    std::size_t chained = 0;
+    for (std::size_t length = 0; length < stats.chain_lengths.size(); length++)
+        chained += length * stats.chain_lengths[length];
+    CHECK(chained == set.Size());
+}
+
+template <template <class, class> class Buckets>
+static void CheckBulkAndParallelInsert() {
+    std::mt19937 random(3);
+    std::vector<int> keys(Scale(300000));
+    for (auto& key : keys)
+        key = static_cast<int>(random() % 200000);
+    const std::set<int> reference(keys.begin(), keys.end());
+
+    StripedHashSet<int, std::hash<int>, Buckets> bulk(16);
+    bulk.Reserve(keys.size());
+    const std::list<int> list(keys.begin(), keys.end());
+    CHECK(bulk.InsertBulk(list.begin(), list.end()) == reference.size());
+    CHECK(bulk.InsertBulk(keys.begin(), keys.end()) == 0);
+    for (int key = 0; key < 200000; key++)
+        CHECK(bulk.Contains(key) == (reference.count(key) == 1));
+
+    ThreadPool<> pool(4, SchedulingMode::WorkStealing);
+    StripedHashSet<int, std::hash<int>, Buckets> parallel(64);
+    std::atomic<bool> stop(false);
+    std::thread reader([&](){
+        std::mt19937 local(7);
+        while (!stop)
+            parallel.Contains(static_cast<int>(local() % 1000));
+    });
+    CHECK(parallel.InsertParallel(keys.begin(), keys.end(), pool) == reference.size());
+    stop = true;
+    reader.join();
+    CHECK(parallel.Size() == reference.size());
+    for (int key = 0; key < 200000; key += 3)
+        CHECK(parallel.Remove(key) == (reference.count(key) == 1));
+}
+
+TEST(hash_set_striped_bulk_insert) {
+    CheckBulkAndParallelInsert<ChainedBuckets>();
+    CheckBulkAndParallelInsert<OpenAddressingBuckets>();
+}
+
+template <template <class, class> class Buckets>
+static void CheckContainsBatch() {
+    std::mt19937 random(3);
+    StripedHashSet<int, std::hash<int>, Buckets> set(16);
+    std::set<int> reference;
+    for (int i = 0; i < 100000; i++) {
+        const int key = static_cast<int>(random() % 300000);
+        set.Insert(key);
+        reference.insert(key);
+    }
+    for (const int count : {0, 1, 63, 64, 65, 1000, 1024}) {
+        std::vector<int> keys(count);
+        for (auto& key : keys)
+            key = static_cast<int>(random() % 300000);
+        std::vector<std::uint64_t> bits((count + 63) / 64 + 1, ~0ULL);
+        set.ContainsBatch(keys.data(), count, bits.data());
+        for (int i = 0; i < count; i++)
+            CHECK(((bits[i / 64] >> (i % 64)) & 1) == reference.count(keys[i]));
+        if (count % 64)
+            CHECK((bits[count / 64] >> (count % 64)) == 0);
+    }
+
+    // Writers toggle keys outside the checked range meanwhile.
+    std::atomic<bool> stop(false);
+    std::thread writer([&](){
+        std::mt19937 local(9);
+        while (!stop) {
+            const int key = 1000000 + static_cast<int>(local() % 100000);
+            if (local() & 1)
+                set.Insert(key);
+            else
+                set.Remove(key);
+        }
+    });
+    std::vector<int> keys(512);
+    for (auto& key : keys)
+        key = static_cast<int>(random() % 300000);
+    std::vector<std::uint64_t> bits(8);
+    for (std::size_t round = 0; round < Scale(2000); round++) {
+        set.ContainsBatch(keys.data(), keys.size(), bits.data());
+        for (int i = 0; i < 512; i++)
+            CHECK(((bits[i / 64] >> (i % 64)) & 1) == reference.count(keys[i]));
+    }
+    stop = true;
+    writer.join();
+}
+
+TEST(hash_set_striped_contains_batch) {
+    CheckContainsBatch<ChainedBuckets>();
+    CheckContainsBatch<OpenAddressingBuckets>();
+}
+
+TEST(hash_set_split_ordered) {
+    SplitOrderedHashSet<std::string> strings;
+    CHECK(strings.Insert("a") && !strings.Insert("a") && strings.Contains("a") && strings.Remove("a") && !strings.Contains("a"));
+
+    ConcurrentSet<int, SetKind::LockFree> single(1);
+    CheckAgainstReference(single, Scale(200000), 5000);
+
+    SplitOrderedHashSet<int> set;
+    CheckDisjointWriters(set);
+
+    // Contended keys: every win is matched by exactly one removal.
+    std::atomic<int> wins(0);
+    RunThreads(4, [&](std::size_t){
+        for (int i = 0; i < static_cast<int>(Scale(5000)); i++)
+            if (set.Insert(-1 - i))
+                wins++;
+        for (int i = 0; i < static_cast<int>(Scale(5000)); i++)
+            if (set.Remove(-1 - i))
+                wins--;
+    });
+    CHECK(wins == 0);
+}
+
+TEST(hash_set_split_ordered_arena) {
+    ArenaAllocator arena(1 << 20, true, ArenaAllocator::kDefaultSlabSize);
+    SplitOrderedHashSet<int> set(arena);
+    std::atomic<long> net(0);
+    RunThreads(4, [&](std::size_t thread){
+        std::mt19937 random(static_cast<unsigned>(thread));
+        for (std::size_t i = 0; i < Scale(200000); i++) {
+            const int key = static_cast<int>(random() % 512);
+            if (random() & 1) {
+                if (set.Insert(key))
+                    net++;
+            } else if (set.Remove(key)) {
+                net--;
+            }
+            set.Contains(key ^ 1);
+        }
+    });
+    CHECK(static_cast<long>(set.Size()) == net);
+}
+
+TEST(hash_set_split_ordered_contains_allocates_nothing) {
+    // Growing leaves most of the new buckets uninitialized; a lookup that
+    // lands in one must search from its parent rather than link it in.
+    ArenaAllocator arena(1 << 20, true);
+    SplitOrderedHashSet<int> set(arena);
+    for (int i = 0; i < 1000; i++)
+        set.Insert(i);
+    CHECK(set.BucketCount() > 64);
+    const std::size_t used = arena.SpaceUsed();
+    for (int i = -20000; i < 20000; i++)
+        CHECK(set.Contains(i) == (i >= 0 && i < 1000));
+    CHECK(arena.SpaceUsed() == used);
+}
+
+TEST(hash_set_cache_line_layout) {
+    CHECK(alignof(SplitOrderedHashSet<int>) == kCacheLineSize && sizeof(SplitOrderedHashSet<int>) % kCacheLineSize == 0);
+}
+
+// A writer grows the set through many stripe migrations while readers
+// look up keys that were there all along: none may go missing midway,
+// in either table of a migrating stripe.
+template <template <class, class> class Buckets>
+static void CheckLookupsDuringRehash() {
+    StripedHashSet<int, std::hash<int>, Buckets> set(2);
+    for (int key = 0; key < 1000; key++)
+        set.Insert(key);
+    std::atomic<bool> stop(false);
+    std::thread writer([&](){
+        for (int i = 0; i < static_cast<int>(Scale(100000)); i++) {
+            CHECK(set.Insert(1000000 + i));
+            if (i % 3 == 0)
+                CHECK(set.Remove(1000000 + i / 2));
+        }
+        stop = true;
+    });
+    RunThreads(2, [&](std::size_t thread){
+        for (int key = static_cast<int>(thread); !stop; key = (key + 2) % 1000)
+            CHECK(set.Contains(key));
+    });
+    writer.join();
+    for (int key = 0; key < 1000; key++)
+        CHECK(set.Contains(key));
+}
+
+TEST(hash_set_striped_incremental_rehash) {
+    CheckLookupsDuringRehash<ChainedBuckets>();
+    CheckLookupsDuringRehash<OpenAddressingBuckets>();
+}
+
+// Writers insert and remove odd keys, shifting slots around the even
+// keys that stay put; optimistic readers must still see every even key
+// and never a key that was not inserted.
+TEST(hash_set_striped_optimistic_contains) {
+    StripedHashSet<int, std::hash<int>, OpenAddressingBuckets> set(4);
+    for (int key = 0; key < 2000; key += 2)
+        set.Insert(key);
+    std::atomic<int> writers(2);
+    RunThreads(4, [&](std::size_t thread){
+        std::mt19937 random(static_cast<unsigned>(thread));
+        if (thread < 2) {
+            for (int i = 0; i < static_cast<int>(Scale(100000)); i++) {
+                const int key = static_cast<int>(random() % 1000) * 2 + 1;
+                if (random() & 1)
+                    set.Insert(key);
+                else
+                    set.Remove(key);
+            }
+            writers--;
+            return;
+        }
+        while (writers) {
+            const int key = static_cast<int>(random() % 1000) * 2;
+            CHECK(set.Contains(key));
+            CHECK(!set.Contains(-1 - key));
+        }
+    });
+    for (int key = 0; key < 2000; key += 2)
+        CHECK(set.Contains(key));
+}
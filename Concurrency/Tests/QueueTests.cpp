@@ -0,0 +1,220 @@
+//
+//  QueueTests.cpp
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Blocking Queue/BlockingQueue.h"
+#include "../Blocking Queue/BoundedMPMCQueue.h"
+#include "../Optimistic Linked List/object_pool.h"
+#include "Testing.h"
+
+// Producers and consumers on a small queue; every element arrives once.
+template <class Queue>
+static void CheckProducersConsumers(Queue& queue, const std::size_t producers, const std::size_t consumers, const int per_producer) {
+    std::atomic<long> sum(0);
+    std::vector<std::thread> threads;
+    for (std::size_t p = 0; p < producers; p++)
+        threads.emplace_back([&](){
+            for (int i = 1; i <= per_producer; i++)
+                queue.Put(int(i));
+        });
+    for (std::size_t c = 0; c < consumers; c++)
+        threads.emplace_back([&](){
+            int element;
+            while (queue.Get(element))
+                sum += element;
+        });
+    for (std::size_t p = 0; p < producers; p++)
+        threads[p].join();
+    queue.Shutdown();
+    for (std::size_t c = producers; c < threads.size(); c++)
+        threads[c].join();
+    CHECK(sum == static_cast<long>(producers) * per_producer * (per_producer + 1) / 2);
+
+    bool threw = false;
+    try {
+        queue.Put(1);
+    } catch (std::bad_exception&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST(queue_blocking_producers_consumers) {
+    BlockingQueue<int> queue(8);
+    CheckProducersConsumers(queue, 3, 3, static_cast<int>(Scale(20000)));
+}
+
+TEST(queue_blocking_batches) {
+    BlockingQueue<int> queue(16);
+    const int rounds = static_cast<int>(Scale(10));
+    std::thread producer([&](){
+        std::vector<int> batch(1000);
+        for (int i = 0; i < 1000; i++)
+            batch[i] = i + 1;
+        for (int round = 0; round < rounds; round++)
+            queue.PutBatch(batch.begin(), batch.end());
+        queue.Shutdown();
+    });
+    std::vector<int> out;
+    while (std::size_t got = queue.GetBatch(std::back_inserter(out), 7))
+        CHECK(got <= 7);
+    producer.join();
+    long sum = 0;
+    for (const int element : out)
+        sum += element;
+    CHECK(sum == rounds * 500500L);
+}
+
+TEST(queue_blocking_stats) {
+    BlockingQueue<int> queue(1);
+    queue.Put(1);
+    std::thread producer([&](){ queue.Put(2); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int element;
+    CHECK(queue.Get(element) && element == 1);
+    producer.join();
+    const BlockingQueueStats stats = queue.GetStats();
+    if (kStatsEnabled)
+        CHECK(stats.put_blocks == 1 && stats.put_blocked_ns > 0);
+    else
+        CHECK(stats.put_blocks == 0 && stats.get_blocks == 0);
+
+    // A consumer that outlasts the spin and waits is counted once.
+    BlockingQueue<int> empty(1);
+    std::thread consumer([&](){ CHECK(empty.Get(element) && element == 3); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    empty.Put(3);
+    consumer.join();
+    if (kStatsEnabled)
+        CHECK(empty.GetStats().get_blocks == 1 && empty.GetStats().get_blocked_ns > 0);
+}
+
+TEST(queue_blocking_pooled_list) {
+    BlockingQueue<std::string, std::list<std::string, PoolAllocator<std::string>>> queue(16);
+    const int count = static_cast<int>(Scale(100000));
+    std::thread producer([&](){
+        for (int i = 0; i < count; i++)
+            queue.Put(std::to_string(i));
+        queue.Shutdown();
+    });
+    std::string element;
+    int received = 0;
+    while (queue.Get(element))
+        CHECK(element == std::to_string(received++));
+    producer.join();
+    CHECK(received == count);
+}
+
+TEST(queue_bounded_mpmc_producers_consumers) {
+    BoundedMPMCQueue<int> queue(8);
+    CheckProducersConsumers(queue, 3, 3, static_cast<int>(Scale(20000)));
+}
+
+TEST(queue_bounded_mpmc_try) {
+    BoundedMPMCQueue<int> queue(2);
+    CHECK(queue.TryPut(1));
+    CHECK(queue.TryPut(2));
+    CHECK(!queue.TryPut(3));
+    int element;
+    CHECK(queue.TryGet(element) && element == 1);
+    CHECK(queue.TryGet(element) && element == 2);
+    CHECK(!queue.TryGet(element));
+
+    // Shutdown closes the tail but leaves what was already put.
+    CHECK(queue.TryPut(4));
+    queue.Shutdown();
+    bool threw = false;
+    try {
+        queue.TryPut(5);
+    } catch (std::bad_exception&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(queue.Get(element) && element == 4);
+    CHECK(!queue.Get(element));
+}
+
+template <SPSCWait wait>
+static void CheckSPSC() {
+    using Queue = BlockingQueue<std::unique_ptr<int>, SingleProducerSingleConsumer<wait>>;
+    const int count = static_cast<int>(Scale(50000));
+    for (const std::size_t capacity : {1, 2, 5, 64}) {
+        Queue queue(capacity);
+        std::thread producer([&](){
+            for (int i = 0; i < count; i++) {
+                if (i % 3) {
+                    queue.Put(std::make_unique<int>(i));
+                    continue;
+                }
+                std::vector<std::unique_ptr<int>> batch;
+                for (int k = 0; k < 7; k++)
+                    batch.push_back(std::make_unique<int>(i));
+                queue.PutBatch(batch.begin(), batch.end());
+            }
+            queue.Shutdown();
+        });
+
+        long received = 0;
+        std::unique_ptr<int> element;
+        std::vector<std::unique_ptr<int>> out(5);
+        while (true) {
+            if (received % 2) {
+                const std::size_t got = queue.GetBatch(out.begin(), 5);
+                if (!got)
+                    break;
+                received += got;
+            } else {
+                if (!queue.Get(element))
+                    break;
+                received++;
+            }
+        }
+        producer.join();
+        CHECK(received == count + (count + 2) / 3 * 6);
+
+        bool threw = false;
+        try {
+            queue.Put(std::make_unique<int>(1));
+        } catch (std::bad_exception&) {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+
+    Queue queue(2);
+    CHECK(queue.TryPut(std::make_unique<int>(1)));
+    CHECK(queue.TryPut(std::make_unique<int>(2)));
+    auto rejected = std::make_unique<int>(3);
+    CHECK(!queue.TryPut(std::move(rejected)));
+    CHECK(rejected);
+    std::unique_ptr<int> element;
+    CHECK(queue.TryGet(element) && *element == 1);
+}
+
+TEST(queue_spsc_park) {
+    CheckSPSC<SPSCWait::Park>();
+}
+
+TEST(queue_spsc_spin) {
+    CheckSPSC<SPSCWait::Spin>();
+}
+
+TEST(queue_cache_line_layout) {
+    // Neighbouring queues, e.g. one per worker, never share a line.
+    CHECK(alignof(BlockingQueue<int>) == kCacheLineSize && sizeof(BlockingQueue<int>) % kCacheLineSize == 0);
+    CHECK(alignof(BoundedMPMCQueue<int>) == kCacheLineSize && sizeof(BoundedMPMCQueue<int>) % kCacheLineSize == 0);
+}
@@ -0,0 +1,77 @@
+//
+//  Testing.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+//  Just enough of a test harness for the stress tests: TEST registers a
+//  case under its name, CHECK reports the failed condition and aborts.
+//  Names start with the group ctest runs them under ("queue_",
+//  "thread_pool_", "hash_set_", "allocator_").
+//
+
+#ifndef Testing_h
+#define Testing_h
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<TestCase>& Tests() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+inline bool RegisterTest(const char* name, void (*run)()) {
+    Tests().push_back(TestCase{name, run});
+    return true;
+}
+
+// --quick divides every iteration count, for sanitizer builds.
+inline std::size_t& TestScaleDivisor() {
+    static std::size_t divisor = 1;
+    return divisor;
+}
+
+inline std::size_t Scale(const std::size_t iterations) {
+    const std::size_t scaled = iterations / TestScaleDivisor();
+    return scaled ? scaled : 1;
+}
+
+[[noreturn]] inline void FailCheck(const char* file, const int line, const char* condition) {
+    std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, condition);
+    std::fflush(stderr);
+    std::abort();
+}
+
+// Runs f(0) ... f(count - 1) on count threads and joins them.
+template <class F>
+void RunThreads(const std::size_t count, F f) {
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < count; i++)
+        threads.emplace_back(f, i);
+    for (auto& thread : threads)
+        thread.join();
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) \
+            FailCheck(__FILE__, __LINE__, #condition); \
+    } while (false)
+
+#define TEST(name) \
+    static void name(); \
+    static const bool name##_registered = RegisterTest(#name, name); \
+    static void name()
+
+#endif /* Testing_h */
@@ -0,0 +1,50 @@
+//
+//  Tests.cpp
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+//  Runs every registered stress test whose name contains the filter, in
+//  registration order, and prints one line per test:
+//
+//      concurrency_tests [--quick] [--filter=<substring>]
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "Testing.h"
+
+int main(int argc, char** argv) {
+    std::string filter;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--quick"))
+            TestScaleDivisor() = 10;
+        else if (!std::strncmp(argv[i], "--filter=", 9))
+            filter = argv[i] + 9;
+        else {
+            std::fprintf(stderr, "usage: %s [--quick] [--filter=<substring>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::size_t run = 0;
+    for (const TestCase& test : Tests()) {
+        if (std::string(test.name).find(filter) == std::string::npos)
+            continue;
+        const auto start = std::chrono::steady_clock::now();
+        test.run();
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%-48s ok  %8.1f ms\n", test.name, ms);
+        std::fflush(stdout);
+        run++;
+    }
+    if (!run) {
+        std::fprintf(stderr, "no test matches \"%s\"\n", filter.c_str());
+        return 1;
+    }
+    return 0;
+}
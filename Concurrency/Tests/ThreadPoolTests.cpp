@@ -0,0 +1,778 @@
+//
+//  ThreadPoolTests.cpp
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "../Thread Pool/ThreadPool.h"
+#include "Testing.h"
+
+static const SchedulingMode kModes[] = {SchedulingMode::SharedQueue, SchedulingMode::WorkStealing};
+
+// Occupies one worker until Open(); Wait() returns once it is running.
+class Gate {
+public:
+    Gate(): opened(open.get_future().share()) {}
+
+    std::function<void()> Task() {
+        std::shared_future<void> until = opened;
+        std::promise<void>* running = &started;
+        return [until, running](){
+            running->set_value();
+            until.wait();
+        };
+    }
+
+    void WaitUntilRunning() {
+        started.get_future().wait();
+    }
+
+    void Open() {
+        open.set_value();
+    }
+
+private:
+    std::promise<void> open;
+    std::shared_future<void> opened;
+    std::promise<void> started;
+};
+
+template <class Result>
+static bool Cancelled(Result& result) {
+    try {
+        result.get();
+    } catch (TaskCancelled&) {
+        return true;
+    }
+    return false;
+}
+
+TEST(thread_pool_submit_and_execute) {
+    for (const SchedulingMode mode : kModes) {
+        ThreadPool<> pool(4, mode);
+        auto number = pool.Submit([](){ return 42; });
+        auto text = pool.Submit([](){ return std::string("hi"); });
+        auto nothing = pool.Submit([](){});
+        auto failure = pool.Submit([]() -> int { throw std::runtime_error("x"); });
+        std::array<char, 200> big{};
+        big[0] = 7;
+        auto heap = pool.Submit([big](){ return static_cast<int>(big[0]); });
+        std::function<int()> function = [](){ return 5; };
+        CHECK(pool.Submit(function).get() == 5);
+
+        std::atomic<int> executed(0);
+        for (int i = 0; i < 1000; i++)
+            pool.Execute([&executed](){ executed++; });
+
+        // Submitted from a worker: stays on its deque in work-stealing mode.
+        std::atomic<int> nested(0);
+        std::vector<std::future<int>> results;
+        const int count = static_cast<int>(Scale(10000));
+        for (int i = 0; i < count; i++)
+            results.push_back(pool.Submit([i, &pool, &nested](){
+                if (i % 10 == 0)
+                    pool.Execute([&nested](){ nested++; });
+                return i;
+            }));
+        long sum = 0;
+        for (auto& result : results)
+            sum += result.get();
+        CHECK(sum == static_cast<long>(count) * (count - 1) / 2);
+
+        CHECK(number.get() == 42 && text.get() == "hi" && heap.get() == 7);
+        nothing.get();
+        bool threw = false;
+        try {
+            failure.get();
+        } catch (std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+        pool.Shutdown();
+        CHECK(executed == 1000);
+        CHECK(nested == (count + 9) / 10);
+    }
+
+    ThreadPool<int> typed(2);
+    CHECK(typed.Submit([](){ return 3; }).get() == 3);
+    ThreadPool<int, BoundedMPMCQueue> lock_free(2);
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 10000; i++)
+        results.push_back(lock_free.Submit([i](){ return i; }));
+    long sum = 0;
+    for (auto& result : results)
+        sum += result.get();
+    CHECK(sum == 10000L * 9999 / 2);
+}
+
+TEST(thread_pool_work_stealing_deque) {
+    // The owner pushes in bursts that outgrow the array and pops some
+    // back while thieves steal and hand in foreign tasks: every value is
+    // taken exactly once.
+    ObjectPool<int> boxes;
+    WorkStealingQueue<int> deque(boxes);
+    const int count = static_cast<int>(Scale(200000));
+    const int foreign_count = 1000;
+    std::vector<std::atomic<int>> taken(count + 3 * foreign_count);
+    std::atomic<int> total(0);
+    std::atomic<bool> pushed(false);
+    RunThreads(4, [&](std::size_t thread){
+        int value;
+        if (thread == 0) {
+            for (int i = 0; i < count; i++) {
+                deque.Push(int(i));
+                if (i % 300 == 299)
+                    for (int j = 0; j < 100 && deque.TryPop(value); j++) {
+                        taken[value]++;
+                        total++;
+                    }
+            }
+            pushed = true;
+        } else {
+            for (int i = 0; i < foreign_count; i++)
+                deque.PushForeign(count + static_cast<int>(thread - 1) * foreign_count + i);
+        }
+        while (total.load() < count + 3 * foreign_count) {
+            if (thread == 0 ? deque.TryPop(value) : deque.TrySteal(value)) {
+                taken[value]++;
+                total++;
+            } else if (pushed) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    bool once = true;
+    for (const std::atomic<int>& times : taken)
+        once = once && times == 1;
+    CHECK(once);
+}
+
+TEST(thread_pool_backpressure) {
+    for (const SchedulingMode mode : kModes) {
+        {
+            ThreadPoolOptions options;
+            options.num_threads = 1;
+            options.mode = mode;
+            options.queue_capacity = 2;
+            options.backpressure = BackpressurePolicy::Reject;
+            ThreadPool<> pool(options);
+            Gate gate;
+            pool.Execute(gate.Task());
+            gate.WaitUntilRunning();
+            pool.Execute([](){});
+            pool.Execute([](){});
+            bool rejected = false;
+            try {
+                pool.Execute([](){});
+            } catch (std::system_error& error) {
+                rejected = error.code() == std::errc::resource_unavailable_try_again;
+            }
+            CHECK(rejected);
+            gate.Open();
+        }
+        {
+            ThreadPoolOptions options;
+            options.num_threads = 1;
+            options.mode = mode;
+            options.queue_capacity = 1;
+            options.backpressure = BackpressurePolicy::CallerRuns;
+            ThreadPool<> pool(options);
+            Gate gate;
+            pool.Execute(gate.Task());
+            gate.WaitUntilRunning();
+            pool.Execute([](){});
+            CHECK(pool.Submit([](){ return std::this_thread::get_id(); }).get() == std::this_thread::get_id());
+            gate.Open();
+        }
+        {
+            // Workers submitting to their own full pool run inline.
+            ThreadPoolOptions options;
+            options.num_threads = 2;
+            options.mode = mode;
+            options.queue_capacity = 2;
+            ThreadPool<> pool(options);
+            std::atomic<int> done(0);
+            for (int i = 0; i < 100; i++)
+                pool.Execute([&](){
+                    for (int j = 0; j < 10; j++)
+                        pool.Execute([&done](){ done++; });
+                });
+            while (done != 1000)
+                std::this_thread::yield();
+            pool.Shutdown();
+        }
+    }
+}
+
+TEST(thread_pool_parallel_algorithms) {
+    for (const SchedulingMode mode : kModes) {
+        ThreadPool<> pool(4, mode);
+        std::vector<int> values(100003);
+        pool.ParallelFor(0, static_cast<int>(values.size()), 0, [&](int i){ values[i] = i; });
+        for (int i = 0; i < static_cast<int>(values.size()); i++)
+            CHECK(values[i] == i);
+
+        const long sum = pool.ParallelReduce(0, static_cast<int>(values.size()), 1000, 0L, [&](int i){ return static_cast<long>(values[i]); }, [](long a, long b){ return a + b; });
+        CHECK(sum == 100002L * 100003 / 2);
+        const std::string alphabet = pool.ParallelReduce(0, 26, 2, std::string(), [](int i){ return std::string(1, static_cast<char>('a' + i)); }, [](std::string a, std::string b){ return a + b; });
+        CHECK(alphabet == "abcdefghijklmnopqrstuvwxyz");
+
+        std::vector<double> doubled(values.size());
+        pool.ParallelTransform(values.begin(), values.end(), doubled.begin(), 0, [](int x){ return x * 2.0; });
+        for (std::size_t i = 0; i < values.size(); i++)
+            CHECK(doubled[i] == 2.0 * i);
+
+        std::atomic<long> nested(0);
+        pool.ParallelFor(0, 50, 1, [&](int){ pool.ParallelFor(0, 1000, 0, [&](int){ nested++; }); });
+        CHECK(nested == 50000);
+
+        bool threw = false;
+        try {
+            pool.ParallelFor(0, 100, 1, [](int i){
+                if (i == 37)
+                    throw std::runtime_error("x");
+            });
+        } catch (std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+        pool.ParallelFor(5, 5, 0, [](int){ FailCheck(__FILE__, __LINE__, "empty range ran"); });
+    }
+}
+
+TEST(thread_pool_futures_and_graphs) {
+    for (const SchedulingMode mode : kModes) {
+        ThreadPool<> pool(4, mode);
+        auto chained = pool.Async([](){ return 20; }).Then([](int x){ return x + 1; }).Then([](int x){ return std::to_string(x * 2); });
+        CHECK(chained.Get() == "42");
+
+        auto failed = pool.Async([]() -> int { throw std::runtime_error("x"); }).Then([](int){ return 2; });
+        bool threw = false;
+        try {
+            failed.Get();
+        } catch (std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+
+        std::vector<Future<int>> numbers;
+        for (int i = 0; i < 100; i++)
+            numbers.push_back(pool.Async([i](){ return i; }));
+        auto total = WhenAll(std::move(numbers)).Then([](std::vector<int> all){ return std::accumulate(all.begin(), all.end(), 0L); });
+        CHECK(total.Get() == 4950);
+
+        // A failure fails WhenAll right away, even behind a running input.
+        Gate gate;
+        std::vector<Future<int>> inputs;
+        inputs.push_back(pool.Async([blocker = gate.Task()](){ blocker(); return 1; }));
+        inputs.push_back(pool.Async([]() -> int { throw std::logic_error("second"); }));
+        auto all = WhenAll(std::move(inputs));
+        gate.WaitUntilRunning();
+        const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!all.IsReady() && std::chrono::steady_clock::now() < give_up)
+            std::this_thread::yield();
+        CHECK(all.IsReady());
+        gate.Open();
+        threw = false;
+        try {
+            all.Get();
+        } catch (std::logic_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+
+        std::vector<Future<int>> race;
+        race.push_back(pool.Async([](){ std::this_thread::sleep_for(std::chrono::milliseconds(50)); return 1; }));
+        race.push_back(pool.Async([](){ return 2; }));
+        const std::size_t first = WhenAny(race).Get();
+        CHECK(race[first].Get() == static_cast<int>(first) + 1);
+
+        for (std::size_t round = 0; round < Scale(200); round++) {
+            TaskGraph graph;
+            std::atomic<int> ticket(0);
+            std::atomic<int> order[4];
+            TaskGraph::Node nodes[4];
+            for (int i = 0; i < 4; i++)
+                nodes[i] = graph.Add([&, i](){ order[i] = ticket++; });
+            graph.Precede(nodes[0], nodes[1]);
+            graph.Precede(nodes[0], nodes[2]);
+            graph.Precede(nodes[1], nodes[3]);
+            graph.Precede(nodes[2], nodes[3]);
+            pool.Run(std::move(graph)).Get();
+            CHECK(order[0] == 0 && order[3] == 3);
+        }
+
+        TaskGraph cycle;
+        auto a = cycle.Add([](){});
+        auto b = cycle.Add([](){});
+        cycle.Precede(a, b);
+        cycle.Precede(b, a);
+        threw = false;
+        try {
+            pool.Run(std::move(cycle));
+        } catch (std::invalid_argument&) {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+}
+
+TEST(thread_pool_priority_lanes) {
+    for (const SchedulingMode mode : kModes) {
+        ThreadPoolOptions options;
+        options.num_threads = 1;
+        options.mode = mode;
+        options.queue_capacity = 1000;
+        options.batch_aging = std::chrono::milliseconds(1000);
+        std::mutex mutex;
+        std::vector<int> order;
+        {
+            ThreadPool<> pool(options);
+            Gate gate;
+            pool.Execute(gate.Task());
+            gate.WaitUntilRunning();
+            for (int i = 0; i < 10; i++)
+                pool.Execute(Priority::Batch, [&, i](){ std::lock_guard<std::mutex> lock(mutex); order.push_back(100 + i); });
+            for (int i = 0; i < 5; i++)
+                pool.Execute(Priority::Interactive, [&, i](){ std::lock_guard<std::mutex> lock(mutex); order.push_back(i); });
+            CHECK(pool.QueueDepth(Priority::Batch) == 10 && pool.QueueDepth(Priority::Interactive) == 5);
+            gate.Open();
+            CHECK(pool.Submit(Priority::Batch, [](){ return 7; }).get() == 7);
+        }
+        CHECK(order.size() == 15);
+        for (int i = 0; i < 5; i++)
+            CHECK(order[i] == i);
+        for (int i = 0; i < 10; i++)
+            CHECK(order[5 + i] == 100 + i);
+
+        // Batch work that has aged past its budget goes first.
+        options.batch_aging = std::chrono::milliseconds(1);
+        order.clear();
+        {
+            ThreadPool<> pool(options);
+            Gate gate;
+            pool.Execute(gate.Task());
+            gate.WaitUntilRunning();
+            pool.Execute(Priority::Batch, [&](){ std::lock_guard<std::mutex> lock(mutex); order.push_back(1); });
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            pool.Execute(Priority::Interactive, [&](){ std::lock_guard<std::mutex> lock(mutex); order.push_back(0); });
+            gate.Open();
+        }
+        CHECK(order.size() == 2 && order[0] == 1 && order[1] == 0);
+
+        for (const BackpressurePolicy backpressure : {BackpressurePolicy::Reject, BackpressurePolicy::Block}) {
+            ThreadPoolOptions stressed;
+            stressed.num_threads = 4;
+            stressed.mode = mode;
+            stressed.queue_capacity = 4;
+            stressed.backpressure = backpressure;
+            ThreadPool<> pool(stressed);
+            std::atomic<int> done(0);
+            std::atomic<int> rejected(0);
+            const int per_thread = static_cast<int>(Scale(20000));
+            RunThreads(4, [&](std::size_t thread){
+                for (int i = 0; i < per_thread; i++) {
+                    try {
+                        pool.Execute(thread % 2 ? Priority::Batch : Priority::Interactive, [&](){ done++; });
+                    } catch (std::system_error&) {
+                        rejected++;
+                    }
+                }
+            });
+            pool.Shutdown();
+            CHECK(done + rejected == 4 * per_thread);
+            CHECK(backpressure == BackpressurePolicy::Reject || rejected == 0);
+        }
+    }
+}
+
+TEST(thread_pool_placement) {
+    for (const WorkerPlacement placement : {WorkerPlacement::None, WorkerPlacement::PinToCore, WorkerPlacement::PinToNode}) {
+        for (const SchedulingMode mode : kModes) {
+            ThreadPoolOptions options;
+            options.num_threads = 4;
+            options.mode = mode;
+            options.placement = placement;
+            options.queue_capacity = ThreadPoolOptions::kUnboundedQueue;
+            ThreadPool<> pool(options);
+            std::atomic<long> sum(0);
+            pool.ParallelFor(0, 100000, 0, [&](int i){ sum += i; });
+            CHECK(sum == 4999950000L);
+        }
+    }
+}
+
+TEST(thread_pool_elastic) {
+    for (const SchedulingMode mode : kModes) {
+        ThreadPoolOptions options;
+        options.num_threads = 2;
+        options.max_threads = 6;
+        options.mode = mode;
+        options.queue_capacity = ThreadPoolOptions::kUnboundedQueue;
+        options.idle_timeout = std::chrono::milliseconds(20);
+        ThreadPool<> pool(options);
+        std::atomic<int> done(0);
+        std::vector<std::future<void>> results;
+        for (int i = 0; i < 200; i++)
+            results.push_back(pool.Submit([&](){
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                done++;
+            }));
+        for (auto& result : results)
+            result.get();
+        CHECK(done == 200);
+
+        // Helpers time out; the pool keeps working with what is left.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        for (std::size_t i = 0; i < Scale(20000); i++)
+            pool.Execute([&](){ done++; });
+        std::atomic<long> sum(0);
+        pool.ParallelFor(0, 10000, 0, [&](int i){ sum += i; });
+        CHECK(sum == 49995000);
+        pool.Shutdown();
+        CHECK(done == 200 + static_cast<int>(Scale(20000)));
+    }
+}
+
+// Runs forever by resubmitting itself, until the pool refuses.
+struct Resubmit {
+    ThreadPool<>* pool;
+
+    void operator()() const {
+        try {
+            pool->Execute(Resubmit{pool});
+        } catch (std::bad_exception&) {
+        }
+    }
+};
+
+TEST(thread_pool_elastic_shutdown) {
+    // Helpers that submit, and so may grow the pool, while Shutdown joins
+    // them.
+    for (const SchedulingMode mode : kModes) {
+        ThreadPoolOptions options;
+        options.num_threads = 1;
+        options.max_threads = 4;
+        options.mode = mode;
+        options.queue_capacity = ThreadPoolOptions::kUnboundedQueue;
+        for (std::size_t round = 0; round < Scale(50); round++) {
+            ThreadPool<> pool(options);
+            for (int chain = 0; chain < 8; chain++)
+                pool.Execute(Resubmit{&pool});
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            pool.Shutdown();
+        }
+    }
+}
+
+TEST(thread_pool_stats) {
+    for (const SchedulingMode mode : kModes) {
+        ThreadPoolOptions options;
+        options.num_threads = 3;
+        options.mode = mode;
+        options.queue_capacity = 2;
+        ThreadPool<> pool(options);
+        std::atomic<int> done(0);
+        for (int i = 0; i < 1000; i++)
+            pool.Execute([&](){ done++; });
+        pool.Submit(Priority::Batch, [&](){ done++; }).get();
+        pool.Shutdown();
+        const ThreadPoolStats stats = pool.GetStats();
+        CHECK(done == 1001);
+        CHECK(stats.completed == stats.submitted);
+        CHECK(!kStatsEnabled || stats.completed >= 1001);
+    }
+}
+
+TEST(thread_pool_shutdown_modes) {
+    using std::chrono::milliseconds;
+    using std::chrono::steady_clock;
+    for (const SchedulingMode mode : kModes) {
+        for (const bool elastic : {false, true}) {
+            ThreadPoolOptions options;
+            options.num_threads = 2;
+            options.mode = mode;
+            options.queue_capacity = ThreadPoolOptions::kUnboundedQueue;
+            options.max_threads = elastic ? 4 : 0;
+
+            {
+                ThreadPool<> pool(options);
+                std::atomic<int> ran(0);
+                std::vector<std::future<void>> results;
+                for (int i = 0; i < 1000; i++)
+                    results.push_back(pool.Submit([&](){ ran++; }));
+                pool.Shutdown(ShutdownMode::Drain);
+                CHECK(ran == 1000);
+                for (auto& result : results)
+                    result.get();
+            }
+
+            {
+                // Two long tasks hold the core workers until the token is
+                // cancelled; everything queued behind them is discarded.
+                ThreadPool<> pool(options);
+                const CancellationToken token = pool.GetCancellationToken();
+                std::atomic<int> started(0);
+                std::atomic<int> ran(0);
+                std::vector<std::future<int>> results;
+                for (int i = 0; i < 2; i++)
+                    results.push_back(pool.Submit([&, token](){
+                        started++;
+                        while (!token.IsCancelled())
+                            std::this_thread::sleep_for(milliseconds(1));
+                        return 1;
+                    }));
+                while (started < 2)
+                    std::this_thread::yield();
+                for (int i = 0; i < 1000; i++)
+                    results.push_back(pool.Submit([&](){ ran++; return 2; }));
+                std::vector<Future<int>> futures;
+                for (int i = 0; i < 100; i++)
+                    futures.push_back(pool.Async([&](){ ran++; return 3; }));
+                for (int i = 0; i < 100; i++)
+                    pool.Execute([&](){ ran++; });
+                auto laned = pool.Submit(Priority::Interactive, [&](){ ran++; });
+                pool.Shutdown(ShutdownMode::Discard);
+
+                CHECK(results[0].get() == 1 && results[1].get() == 1);
+                int cancelled = 0;
+                for (std::size_t i = 2; i < results.size(); i++)
+                    cancelled += Cancelled(results[i]);
+                for (auto& future : futures) {
+                    try {
+                        future.Get();
+                    } catch (TaskCancelled&) {
+                        cancelled++;
+                    }
+                }
+                cancelled += Cancelled(laned);
+                // Elastic helpers may have run some of it before Shutdown.
+                CHECK(elastic ? cancelled + ran <= 1201 : cancelled == 1101 && ran == 0);
+            }
+
+            {
+                ThreadPool<> pool(options);
+                const CancellationToken token = pool.GetCancellationToken();
+                std::atomic<int> ran(0);
+                std::vector<std::future<void>> results;
+                for (int i = 0; i < 200; i++)
+                    results.push_back(pool.Submit([&, token](){
+                        for (int k = 0; k < 10 && !token.IsCancelled(); k++)
+                            std::this_thread::sleep_for(milliseconds(1));
+                        ran++;
+                    }));
+                pool.Shutdown(ShutdownMode::Deadline, steady_clock::now() + milliseconds(50));
+                int cancelled = 0;
+                for (auto& result : results)
+                    cancelled += Cancelled(result);
+                CHECK(cancelled > 0 && cancelled + ran == 200);
+            }
+
+            {
+                ThreadPool<> pool(options);
+                std::atomic<int> ran(0);
+                for (int i = 0; i < 100; i++)
+                    pool.Execute([&](){ ran++; });
+                pool.Shutdown(ShutdownMode::Deadline, steady_clock::now() + std::chrono::seconds(30));
+                CHECK(ran == 100);
+                CHECK(!pool.GetCancellationToken().IsCancelled());
+            }
+        }
+    }
+
+    CancellationSource source;
+    const CancellationToken token = source.Token();
+    CHECK(!token.IsCancelled());
+    source.Cancel();
+    CHECK(token.IsCancelled());
+    bool threw = false;
+    try {
+        token.ThrowIfCancelled();
+    } catch (TaskCancelled&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(!CancellationToken().IsCancelled());
+}
+
+TEST(thread_pool_tracer) {
+    for (const SchedulingMode mode : kModes) {
+        TaskTracer tracer(10);
+        ThreadPoolOptions options;
+        options.num_threads = 3;
+        options.mode = mode;
+        options.tracer = &tracer;
+        {
+            ThreadPool<> pool(options);
+            std::vector<std::future<int>> results;
+            for (int i = 0; i < 1000; i++)
+                results.push_back(pool.Submit([i](){ return i; }));
+            for (int i = 0; i < 100; i++)
+                results.push_back(pool.SubmitBefore(Priority::Interactive, std::chrono::steady_clock::now(), [i](){ return i; }));
+            std::ostringstream while_running;
+            tracer.WriteChromeTrace(while_running);
+            for (auto& result : results)
+                result.get();
+            tracer.SetSampleEvery(0);
+            for (int i = 0; i < 100; i++)
+                pool.Submit([](){ return 0; }).get();
+        }
+
+        std::ostringstream out;
+        tracer.WriteChromeTrace(out);
+        const std::string trace = out.str();
+        std::size_t runs = 0;
+        for (std::size_t at = trace.find("\"run\""); at != std::string::npos; at = trace.find("\"run\"", at + 1))
+            runs++;
+        CHECK(runs == 110);
+        CHECK(trace.compare(0, 16, "{\"traceEvents\":[") == 0);
+    }
+}
+
+TEST(thread_pool_tracer_ring_reuse) {
+    // Threads that come and go hand their rings on instead of adding more.
+    TaskTracer tracer(1, 64);
+    for (std::size_t round = 0; round < Scale(100); round++)
+        RunThreads(4, [&](std::size_t){
+            const std::uint64_t task = tracer.Sample();
+            tracer.Record(task, TracePhase::Enqueue);
+        });
+    std::ostringstream out;
+    tracer.WriteChromeTrace(out);
+    const std::string trace = out.str();
+    std::size_t rings = 0;
+    for (std::size_t at = trace.find("thread_name"); at != std::string::npos; at = trace.find("thread_name", at + 1))
+        rings++;
+    CHECK(rings >= 1 && rings <= 4);
+    CHECK(trace.find("\"submit\"") != std::string::npos);
+}
+
+#if defined(__cpp_impl_coroutine)
+
+using IntQueue = BlockingQueue<int>;
+
+static Future<long> SumAll(IntQueue& queue, ThreadPool<>& pool) {
+    co_await pool.Schedule();
+    long sum = 0;
+    int element;
+    while (co_await queue.AsyncGet(element))
+        sum += element;
+    co_return sum;
+}
+
+static Future<void> PutRange(IntQueue& queue, ThreadPool<>& pool, const int from, const int count) {
+    co_await pool.Schedule();
+    for (int i = from; i < from + count; i++)
+        co_await queue.AsyncPut(int(i));
+}
+
+static Future<int> Twice(ThreadPool<>& pool, const int value) {
+    const int result = co_await pool.Async([value](){ return value * 2; });
+    co_return result;
+}
+
+static Future<int> Throw(ThreadPool<>& pool) {
+    co_await pool.Schedule();
+    throw std::runtime_error("x");
+}
+
+static Future<void> PutOne(IntQueue& queue, bool& threw) {
+    try {
+        co_await queue.AsyncPut(1);
+    } catch (std::bad_exception&) {
+        threw = true;
+    }
+}
+
+TEST(thread_pool_coroutines) {
+    for (const SchedulingMode mode : kModes) {
+        ThreadPool<> pool(4, mode);
+        IntQueue queue(8);
+        const int producers = 50;
+        const int per_producer = static_cast<int>(Scale(200));
+        std::vector<Future<long>> consumers;
+        for (int i = 0; i < 1000; i++)
+            consumers.push_back(SumAll(queue, pool));
+        std::vector<Future<void>> puts;
+        for (int p = 0; p < producers; p++)
+            puts.push_back(PutRange(queue, pool, p * per_producer, per_producer));
+        const int last = producers * per_producer;
+        std::thread blocking([&](){
+            for (int i = last; i < last + 1000; i++)
+                queue.Put(int(i));
+        });
+        for (auto& put : puts)
+            put.Get();
+        blocking.join();
+        std::vector<int> batch(100);
+        std::iota(batch.begin(), batch.end(), last + 1000);
+        queue.PutBatch(batch.begin(), batch.end());
+        queue.Shutdown();
+
+        long total = 0;
+        for (auto& consumer : consumers)
+            total += consumer.Get();
+        const long count = last + 1100;
+        CHECK(total == count * (count - 1) / 2);
+
+        CHECK(Twice(pool, 21).Get() == 42);
+        bool threw = false;
+        try {
+            Throw(pool).Get();
+        } catch (std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+        threw = false;
+        PutOne(queue, threw).Get();
+        CHECK(threw);
+    }
+
+    // Suspended producers are released by a blocking consumer and by
+    // Shutdown.
+    ThreadPool<> pool(2);
+    IntQueue queue(2);
+    std::vector<Future<void>> puts;
+    for (int p = 0; p < 10; p++)
+        puts.push_back(PutRange(queue, pool, p * 100, 100));
+    long sum = 0;
+    for (std::size_t received = 0; received < 1000; ) {
+        std::vector<int> out(3);
+        const std::size_t got = queue.GetBatch(out.begin(), 3);
+        for (std::size_t i = 0; i < got; i++)
+            sum += out[i];
+        received += got;
+    }
+    for (auto& put : puts)
+        put.Get();
+    CHECK(sum == 999L * 1000 / 2);
+
+    IntQueue full(1);
+    full.Put(1);
+    bool threw = false;
+    auto blocked = PutOne(full, threw);
+    CHECK(!blocked.IsReady());
+    full.Shutdown();
+    blocked.Get();
+    CHECK(threw);
+}
+
+#endif
@@ -0,0 +1,72 @@
+//
+//  Cancellation.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef Cancellation_h
+#define Cancellation_h
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+// The error a cancelled task's future reports, and what
+// CancellationToken::ThrowIfCancelled throws.
+class TaskCancelled: public std::runtime_error {
+public:
+    TaskCancelled(): std::runtime_error("task cancelled") {}
+};
+
+
+// Read side of a CancellationSource. Cancellation is cooperative: a
+// long-running task polls its token now and then, which costs one load,
+// and returns early once it is set. A default token is never cancelled.
+class CancellationToken {
+public:
+    CancellationToken() = default;
+
+    bool IsCancelled() const {
+        return flag && flag->load(std::memory_order_acquire);
+    }
+
+    void ThrowIfCancelled() const {
+        if (IsCancelled())
+            throw TaskCancelled();
+    }
+
+private:
+    friend class CancellationSource;
+
+    explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> flag): flag(std::move(flag)) {}
+
+    std::shared_ptr<const std::atomic<bool>> flag;
+};
+
+
+// Cancel() sets every token handed out, before or after the call. Tokens
+// share the flag, so they may outlive the source.
+class CancellationSource {
+public:
+    CancellationSource(): flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void Cancel() {
+        flag->store(true, std::memory_order_release);
+    }
+
+    bool IsCancelled() const {
+        return flag->load(std::memory_order_acquire);
+    }
+
+    CancellationToken Token() const {
+        return CancellationToken(flag);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+#endif /* Cancellation_h */
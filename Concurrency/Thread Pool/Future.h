@@ -0,0 +1,533 @@
+//
+//  Future.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef Future_h
+#define Future_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+#include "Task.h"
+
+// Where continuations run. A default Executor runs them inline in the
+// thread that completed the antecedent; ThreadPool::GetExecutor() hands
+// them to the pool.
+struct Executor {
+    void* context = nullptr;
+    void (*schedule)(void* context, Task&& task) = nullptr;
+
+    void Schedule(Task&& task) const {
+        if (schedule)
+            schedule(context, std::move(task));
+        else
+            task();
+    }
+};
+
+
+template <class R>
+class Future;
+
+template <class R>
+struct FuturePromise;
+
+// Shared state behind a Future: the result (or exception) plus the
+// callbacks waiting for it. void results are stored as an empty Unit.
+template <class R>
+class FutureState {
+public:
+    struct Unit {};
+    using Stored = typename std::conditional<std::is_void<R>::value, Unit, R>::type;
+
+    explicit FutureState(const Executor& executor): executor(executor), ready(false) {}
+
+    void SetValue(Stored&& result) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            value.emplace(std::move(result));
+        }
+        Complete();
+    }
+
+    void SetError(std::exception_ptr exception) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = exception;
+        }
+        Complete();
+    }
+
+    // callback runs exactly once after completion: on the executor, or
+    // right in the completing thread for the combinators' own glue code.
+    void Subscribe(Task&& callback, const bool run_inline = false) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ready.load(std::memory_order_relaxed)) {
+                callbacks.push_back(Callback{std::move(callback), run_inline});
+                return;
+            }
+        }
+        Run(Callback{std::move(callback), run_inline});
+    }
+
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready_cv.wait(lock, [this](){ return ready.load(std::memory_order_relaxed); });
+    }
+
+    bool IsReady() const {
+        return ready.load(std::memory_order_acquire);
+    }
+
+    // Only valid once ready.
+    bool Failed() const {
+        return static_cast<bool>(error);
+    }
+
+    std::exception_ptr Error() const {
+        return error;
+    }
+
+    Stored Take() {
+        if (error)
+            std::rethrow_exception(error);
+        return std::move(*value);
+    }
+
+    const Executor& GetExecutor() const {
+        return executor;
+    }
+
+private:
+
+    struct Callback {
+        Task task;
+        bool run_inline;
+    };
+
+    void Complete() {
+        std::vector<Callback> waiting;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.store(true, std::memory_order_release);
+            waiting.swap(callbacks);
+        }
+        ready_cv.notify_all();
+        for (auto& callback : waiting)
+            Run(std::move(callback));
+    }
+
+    void Run(Callback&& callback) {
+        if (callback.run_inline)
+            callback.task();
+        else
+            executor.Schedule(std::move(callback.task));
+    }
+
+    const Executor executor;
+
+    std::mutex mutex;
+    std::condition_variable ready_cv;
+    std::atomic<bool> ready;
+
+    std::optional<Stored> value;
+    std::exception_ptr error;
+    std::vector<Callback> callbacks;
+};
+
+
+// Stores the outcome of function() into state.
+template <class R, class F>
+void CompleteWith(FutureState<R>& state, F&& function) {
+    try {
+        if constexpr (std::is_void<R>::value) {
+            function();
+            state.SetValue(typename FutureState<R>::Unit());
+        } else {
+            state.SetValue(function());
+        }
+    } catch (...) {
+        state.SetError(std::current_exception());
+    }
+}
+
+
+// Move-only handle to a result produced on a pool. Then attaches a
+// continuation that is scheduled on the same executor as soon as the
+// result is there, so dependent work never parks a worker in Get().
+// An exception skips the continuation and propagates down the chain.
+//
+// With C++20 coroutines a Future can also be co_await'ed, which resumes
+// the awaiting coroutine on the future's executor instead of blocking,
+// and a coroutine can return Future<R>: it runs eagerly up to its first
+// suspension, and the Future holds whatever it co_returns or throws.
+// Such a Future has the inline executor, so an awaiter is resumed right
+// where the coroutine finished.
+template <class R>
+class Future {
+public:
+#if defined(__cpp_impl_coroutine)
+    using promise_type = FuturePromise<R>;
+#endif
+
+    Future() = default;
+
+    explicit Future(std::shared_ptr<FutureState<R>> state): state(std::move(state)) {}
+
+    Future(Future&& other) = default;
+    Future& operator=(Future&& other) = default;
+
+    Future(const Future& other) = delete;
+    Future& operator=(const Future& other) = delete;
+
+    bool Valid() const {
+        return static_cast<bool>(state);
+    }
+
+    bool IsReady() const {
+        return state->IsReady();
+    }
+
+    void Wait() const {
+        state->Wait();
+    }
+
+    // Blocks until ready, then returns the result or rethrows. Like
+    // std::future::get it may be called once.
+    R Get() {
+        state->Wait();
+        std::shared_ptr<FutureState<R>> current = std::move(state);
+        if constexpr (std::is_void<R>::value)
+            current->Take();
+        else
+            return current->Take();
+    }
+
+    // function receives the result (nothing for void) and may return
+    // anything; the returned Future holds what it returns.
+    template <class F>
+    auto Then(F&& function) {
+        using Function = typename std::decay<F>::type;
+        using Next = typename ContinuationResult<Function>::type;
+
+        auto next = std::make_shared<FutureState<Next>>(state->GetExecutor());
+        std::shared_ptr<FutureState<R>> antecedent = std::move(state);
+        FutureState<R>* source = antecedent.get();
+        source->Subscribe(Task([antecedent, next, function = Function(std::forward<F>(function))]() mutable {
+            if (antecedent->Failed()) {
+                next->SetError(antecedent->Error());
+                return;
+            }
+            CompleteWith(*next, [&]() -> Next {
+                if constexpr (std::is_void<R>::value)
+                    return function();
+                else
+                    return function(antecedent->Take());
+            });
+        }));
+        return Future<Next>(std::move(next));
+    }
+
+#if defined(__cpp_impl_coroutine)
+    bool await_ready() const {
+        return state->IsReady();
+    }
+
+    // A ready state resumes the coroutine inside Subscribe, and its
+    // await_resume drops our reference, so one is held for the call.
+    void await_suspend(std::coroutine_handle<> handle) {
+        const std::shared_ptr<FutureState<R>> current = state;
+        current->Subscribe(Task([handle]() { handle.resume(); }));
+    }
+
+    R await_resume() {
+        return Get();
+    }
+#endif
+
+private:
+
+    template <class Function, bool = std::is_void<R>::value>
+    struct ContinuationResult {
+        using type = decltype(std::declval<Function&>()());
+    };
+
+    template <class Function>
+    struct ContinuationResult<Function, false> {
+        using type = decltype(std::declval<Function&>()(std::declval<R>()));
+    };
+
+    template <class U>
+    friend class Future;
+
+    template <class U>
+    friend auto WhenAll(std::vector<Future<U>> futures);
+
+    template <class U>
+    friend Future<std::size_t> WhenAny(const std::vector<Future<U>>& futures);
+
+    std::shared_ptr<FutureState<R>> state;
+};
+
+
+#if defined(__cpp_impl_coroutine)
+// The promise of a coroutine returning Future<R>. Neither suspension
+// point waits: the frame is destroyed as soon as the body is done, and
+// the shared state alone carries the result.
+template <class R>
+struct FuturePromiseBase {
+    std::shared_ptr<FutureState<R>> state = std::make_shared<FutureState<R>>(Executor());
+
+    Future<R> get_return_object() {
+        return Future<R>(state);
+    }
+
+    std::suspend_never initial_suspend() const noexcept {
+        return {};
+    }
+
+    std::suspend_never final_suspend() const noexcept {
+        return {};
+    }
+
+    void unhandled_exception() {
+        state->SetError(std::current_exception());
+    }
+};
+
+template <class R>
+struct FuturePromise: FuturePromiseBase<R> {
+    void return_value(R result) {
+        this->state->SetValue(std::move(result));
+    }
+};
+
+template <>
+struct FuturePromise<void>: FuturePromiseBase<void> {
+    void return_void() {
+        state->SetValue(FutureState<void>::Unit());
+    }
+};
+
+
+// co_await ScheduleAwaiter{executor} suspends the coroutine and resumes
+// it from a task handed to executor, e.g. on a pool worker.
+struct ScheduleAwaiter {
+    Executor executor;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    // The executor may resume the coroutine before Schedule returns, and
+    // the coroutine may be gone by then, so the awaiter is copied first.
+    void await_suspend(std::coroutine_handle<> handle) const {
+        const Executor target = executor;
+        target.Schedule(Task([handle]() { handle.resume(); }));
+    }
+
+    void await_resume() const noexcept {}
+};
+#endif
+
+
+// Ready once every input is, with all results in input order (nothing
+// for void), or as soon as any input fails, with that input's exception:
+// the first to fail in time, not in input order. Inputs still running
+// then finish unobserved.
+template <class R>
+auto WhenAll(std::vector<Future<R>> futures) {
+    using Result = typename std::conditional<std::is_void<R>::value, void, std::vector<R>>::type;
+
+    struct Gather {
+        std::vector<Future<R>> inputs;
+        std::atomic<std::size_t> remaining;
+        std::atomic<bool> failed{false};
+        std::shared_ptr<FutureState<Result>> output;
+    };
+
+    const Executor executor = futures.empty() ? Executor() : futures.front().state->GetExecutor();
+    auto gather = std::make_shared<Gather>();
+    gather->remaining.store(futures.size());
+    gather->output = std::make_shared<FutureState<Result>>(executor);
+    gather->inputs = std::move(futures);
+
+    auto finish = [](Gather& all) {
+        CompleteWith(*all.output, [&all]() -> Result {
+            if constexpr (!std::is_void<R>::value) {
+                std::vector<R> results;
+                results.reserve(all.inputs.size());
+                for (auto& input : all.inputs)
+                    results.push_back(input.state->Take());
+                return results;
+            }
+        });
+    };
+
+    Future<Result> result(gather->output);
+    if (gather->inputs.empty()) {
+        finish(*gather);
+        return result;
+    }
+    // A failure is flagged before its input counts down, so whoever
+    // counts down last sees it.
+    for (auto& input : gather->inputs)
+        input.state->Subscribe(Task([gather, finish, state = input.state.get()](){
+            if (state->Failed() && !gather->failed.exchange(true))
+                gather->output->SetError(state->Error());
+            if (gather->remaining.fetch_sub(1) == 1 && !gather->failed.load())
+                finish(*gather);
+        }), true);
+    return result;
+}
+
+
+// Ready with the index of the first input to complete, successfully or
+// not; the inputs stay with the caller, who takes the winner's result.
+template <class R>
+Future<std::size_t> WhenAny(const std::vector<Future<R>>& futures) {
+    if (futures.empty())
+        throw std::invalid_argument("WhenAny of no futures");
+
+    auto output = std::make_shared<FutureState<std::size_t>>(futures.front().state->GetExecutor());
+    auto decided = std::make_shared<std::atomic<bool>>(false);
+    for (std::size_t i = 0; i < futures.size(); i++)
+        futures[i].state->Subscribe(Task([output, decided, i](){
+            if (!decided->exchange(true))
+                output->SetValue(std::size_t(i));
+        }), true);
+    return Future<std::size_t>(std::move(output));
+}
+
+
+// A DAG of void() tasks: Add returns a node id, Precede(a, b) makes b wait
+// for a. Handed to ThreadPool::Run in one call, every node becomes a pool
+// task the moment its last predecessor finishes. After a node throws,
+// nodes not yet started are skipped and the graph's Future reports the
+// first exception.
+class TaskGraph {
+public:
+    using Node = std::size_t;
+
+    template <class F>
+    Node Add(F&& function) {
+        nodes.push_back(NodeData{Task(std::forward<F>(function)), {}, 0});
+        return nodes.size() - 1;
+    }
+
+    void Precede(const Node before, const Node after) {
+        nodes.at(before).successors.push_back(after);
+        nodes.at(after).num_predecessors++;
+    }
+
+    std::size_t Size() const {
+        return nodes.size();
+    }
+
+    // Starts the graph; throws std::invalid_argument if it has a cycle.
+    Future<void> Run(const Executor& executor) && {
+        CheckAcyclic();
+
+        auto run = std::make_shared<GraphRun>(executor, std::move(nodes));
+        Future<void> result(run->done);
+        if (run->nodes.empty()) {
+            run->done->SetValue(FutureState<void>::Unit());
+            return result;
+        }
+        for (Node node = 0; node < run->nodes.size(); node++)
+            if (run->nodes[node].num_predecessors == 0)
+                GraphRun::Schedule(run, node);
+        return result;
+    }
+
+private:
+
+    struct NodeData {
+        Task task;
+        std::vector<Node> successors;
+        std::size_t num_predecessors;
+    };
+
+    struct GraphRun {
+        GraphRun(const Executor& executor, std::vector<NodeData>&& graph): executor(executor), nodes(std::move(graph)), remaining(new std::atomic<std::size_t>[nodes.size()]), unfinished(nodes.size()), failed(false), done(std::make_shared<FutureState<void>>(executor)) {
+            for (std::size_t i = 0; i < nodes.size(); i++)
+                remaining[i].store(nodes[i].num_predecessors);
+        }
+
+        static void Schedule(const std::shared_ptr<GraphRun>& run, const Node node) {
+            run->executor.Schedule(Task([run, node](){ Execute(run, node); }));
+        }
+
+        static void Execute(const std::shared_ptr<GraphRun>& run, const Node node) {
+            if (!run->failed.load()) {
+                try {
+                    run->nodes[node].task();
+                } catch (...) {
+                    if (!run->failed.exchange(true))
+                        run->error = std::current_exception();
+                }
+            }
+            for (Node successor : run->nodes[node].successors)
+                if (run->remaining[successor].fetch_sub(1) == 1)
+                    Schedule(run, successor);
+            if (run->unfinished.fetch_sub(1) == 1) {
+                if (run->error)
+                    run->done->SetError(run->error);
+                else
+                    run->done->SetValue(FutureState<void>::Unit());
+            }
+        }
+
+        const Executor executor;
+        std::vector<NodeData> nodes;
+        std::unique_ptr<std::atomic<std::size_t>[]> remaining;
+        std::atomic<std::size_t> unfinished;
+        std::atomic<bool> failed;
+        std::exception_ptr error;
+        std::shared_ptr<FutureState<void>> done;
+    };
+
+    // Kahn's algorithm over the predecessor counts.
+    void CheckAcyclic() const {
+        std::vector<std::size_t> indegree(nodes.size());
+        std::vector<Node> ready;
+        for (Node node = 0; node < nodes.size(); node++) {
+            indegree[node] = nodes[node].num_predecessors;
+            if (!indegree[node])
+                ready.push_back(node);
+        }
+        std::size_t visited = 0;
+        while (!ready.empty()) {
+            const Node node = ready.back();
+            ready.pop_back();
+            visited++;
+            for (Node successor : nodes[node].successors)
+                if (--indegree[successor] == 0)
+                    ready.push_back(successor);
+        }
+        if (visited != nodes.size())
+            throw std::invalid_argument("TaskGraph has a cycle");
+    }
+
+    std::vector<NodeData> nodes;
+};
+
+#endif /* Future_h */
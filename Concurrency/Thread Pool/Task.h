@@ -0,0 +1,169 @@
+//
+//  Task.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef Task_h
+#define Task_h
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only, type-erased void() callable. Callables of up to kInlineSize
+// bytes that can be moved without throwing live inside the Task itself,
+// so wrapping the common small lambda costs no allocation; bigger ones
+// are moved to the heap. One Task is exactly one cache line.
+//
+// Cancel() is the alternative to running a Task that will never get its
+// turn: a callable with a Cancel() member is told so (and e.g. fails its
+// promise), any other callable is run as usual, since it may be glue
+// whose completion somebody is waiting for.
+class Task {
+public:
+    static constexpr std::size_t kInlineSize = 56;
+
+    Task() noexcept: vtable(nullptr) {}
+
+    template <class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& function): vtable(nullptr) {
+        using Function = typename std::decay<F>::type;
+        if constexpr (fits_inline<Function>()) {
+            new (storage) Function(std::forward<F>(function));
+            vtable = &inline_vtable<Function>;
+        } else {
+            *reinterpret_cast<Function**>(storage) = new Function(std::forward<F>(function));
+            vtable = &heap_vtable<Function>;
+        }
+    }
+
+    Task(Task&& other) noexcept: vtable(other.vtable) {
+        if (vtable) {
+            vtable->move(other.storage, storage);
+            other.vtable = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            vtable = other.vtable;
+            if (vtable) {
+                vtable->move(other.storage, storage);
+                other.vtable = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task& other) = delete;
+    Task& operator=(const Task& other) = delete;
+
+    ~Task() {
+        reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return vtable != nullptr;
+    }
+
+    void operator()() {
+        vtable->invoke(storage);
+    }
+
+    void Cancel() {
+        vtable->cancel(storage);
+    }
+
+    void reset() noexcept {
+        if (vtable) {
+            vtable->destroy(storage);
+            vtable = nullptr;
+        }
+    }
+
+private:
+
+    struct VTable {
+        void (*invoke)(void* storage);
+        void (*cancel)(void* storage);
+        void (*move)(void* from, void* to) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <class Function>
+    static constexpr bool fits_inline() {
+        return sizeof(Function) <= kInlineSize &&
+               alignof(Function) <= alignof(void*) &&
+               std::is_nothrow_move_constructible<Function>::value;
+    }
+
+    template <class Function, class = void>
+    struct has_cancel: std::false_type {};
+
+    template <class Function>
+    struct has_cancel<Function, std::void_t<decltype(std::declval<Function&>().Cancel())>>: std::true_type {};
+
+    template <class Function>
+    static void cancel(Function& function) {
+        if constexpr (has_cancel<Function>::value)
+            function.Cancel();
+        else
+            function();
+    }
+
+    template <class Function>
+    static void inline_invoke(void* storage) {
+        (*static_cast<Function*>(storage))();
+    }
+
+    template <class Function>
+    static void inline_cancel(void* storage) {
+        cancel(*static_cast<Function*>(storage));
+    }
+
+    template <class Function>
+    static void inline_move(void* from, void* to) noexcept {
+        new (to) Function(std::move(*static_cast<Function*>(from)));
+        static_cast<Function*>(from)->~Function();
+    }
+
+    template <class Function>
+    static void inline_destroy(void* storage) noexcept {
+        static_cast<Function*>(storage)->~Function();
+    }
+
+    template <class Function>
+    static void heap_invoke(void* storage) {
+        (**static_cast<Function**>(storage))();
+    }
+
+    template <class Function>
+    static void heap_cancel(void* storage) {
+        cancel(**static_cast<Function**>(storage));
+    }
+
+    static void heap_move(void* from, void* to) noexcept {
+        *static_cast<void**>(to) = *static_cast<void**>(from);
+    }
+
+    template <class Function>
+    static void heap_destroy(void* storage) noexcept {
+        delete *static_cast<Function**>(storage);
+    }
+
+    template <class Function>
+    static constexpr VTable inline_vtable = {&inline_invoke<Function>, &inline_cancel<Function>, &inline_move<Function>, &inline_destroy<Function>};
+
+    template <class Function>
+    static constexpr VTable heap_vtable = {&heap_invoke<Function>, &heap_cancel<Function>, &heap_move, &heap_destroy<Function>};
+
+    alignas(void*) unsigned char storage[kInlineSize];
+    const VTable* vtable;
+};
+
+#endif /* Task_h */
@@ -0,0 +1,385 @@
+//
+//  TaskTracer.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef TaskTracer_h
+#define TaskTracer_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "Task.h"
+
+// Where a sampled task is in its life. Submit and Enqueue are recorded by
+// the submitting thread (Enqueue once the queue has accepted the task),
+// the others by the worker that runs it: Dequeue when the pool takes the
+// task off its queue, Start and Finish around the callable itself.
+enum class TracePhase : std::uint8_t {
+    Submit,
+    Enqueue,
+    Dequeue,
+    Start,
+    Finish
+};
+
+
+// Samples one in every sample_every submissions (0 turns sampling off,
+// leaving one relaxed load per submission) and records the phases of the
+// sampled tasks. Every thread appends to its own ring of ring_capacity
+// events, overwriting its oldest ones, so recording takes no lock and
+// no shared cache line. A thread that exits gives its ring up, and the
+// next thread to record takes it over, tid and old events included, so
+// threads that come and go cost no more rings than ever ran at once.
+// WriteChromeTrace may run at any time and skips events that are being
+// overwritten while it reads them.
+//
+// The tracer must outlive every pool it is attached to (see
+// ThreadPoolOptions::tracer).
+class TaskTracer {
+public:
+    static constexpr std::size_t kDefaultRingCapacity = 1 << 14;
+
+    explicit TaskTracer(const std::size_t sample_every = 0, const std::size_t ring_capacity = kDefaultRingCapacity): id(NextTracerId()), ring_capacity(round_up(ring_capacity)), origin(std::chrono::steady_clock::now()), registry(std::make_shared<Registry>()), sample_every(sample_every), next_task(1) {}
+
+    TaskTracer(const TaskTracer& other) = delete;
+    TaskTracer& operator=(const TaskTracer& other) = delete;
+
+    ~TaskTracer() {
+        registry->alive.store(false);
+    }
+
+    void SetSampleEvery(const std::size_t every) {
+        sample_every.store(every, std::memory_order_relaxed);
+    }
+
+    // 0 if this submission is not sampled; otherwise a fresh task id
+    // whose Submit is already recorded.
+    std::uint64_t Sample() {
+        const std::size_t every = sample_every.load(std::memory_order_relaxed);
+        if (every == 0)
+            return 0;
+        return SampleOne(every);
+    }
+
+    void Record(const std::uint64_t task, const TracePhase phase) {
+        LocalRing().Append(task, phase, Now());
+    }
+
+    // task, recording Start and Finish around it when run.
+    Task RecordRun(const std::uint64_t task_id, Task&& task) {
+        return Task(RunSpan{this, std::move(task), task_id});
+    }
+
+    // task, recording Dequeue as soon as a worker calls it.
+    Task RecordDequeue(const std::uint64_t task_id, Task&& task) {
+        return Task(DequeueMark{this, std::move(task), task_id});
+    }
+
+    // The sampled tasks in Chrome's trace event format, which Perfetto
+    // and chrome://tracing load: a "submit" slice on the submitting
+    // thread (Put blocked under backpressure shows here), a "run" slice on
+    // the worker with the queueing delays as args, a flow arrow between
+    // the two, and an async "queued" slice from Enqueue to Dequeue.
+    void WriteChromeTrace(std::ostream& out) const {
+        std::vector<Event> events;
+        for (Ring* ring = registry->head.load(std::memory_order_acquire); ring != nullptr; ring = ring->next)
+            ring->Collect(events);
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b){
+            return a.task != b.task ? a.task < b.task : a.phase < b.phase;
+        });
+
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        auto separate = [&](){
+            if (!first)
+                out << ",\n";
+            first = false;
+        };
+        for (std::uint32_t thread = 0; thread < registry->num_rings.load(); thread++) {
+            separate();
+            out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":\"thread " << thread << "\"}}";
+        }
+
+        for (std::size_t begin = 0; begin < events.size(); ) {
+            std::size_t end = begin;
+            const Event* phase[kNumPhases] = {};
+            while (end < events.size() && events[end].task == events[begin].task) {
+                phase[static_cast<std::size_t>(events[end].phase)] = &events[end];
+                end++;
+            }
+            WriteTask(out, events[begin].task, phase, separate);
+            begin = end;
+        }
+        out << "\n]}\n";
+    }
+
+private:
+
+    static constexpr std::size_t kNumPhases = 5;
+
+    struct Event {
+        std::uint64_t task;
+        TracePhase phase;
+        std::uint64_t time_ns;
+        std::uint32_t thread;
+    };
+
+    // One writer, any number of readers: each slot is a seqlock whose
+    // sequence is odd while the owner rewrites it.
+    struct Slot {
+        std::atomic<std::uint64_t> sequence{0};
+        std::atomic<std::uint64_t> task{0};
+        std::atomic<std::uint64_t> stamp{0};    // time_ns << 3 | phase
+    };
+
+    struct Ring {
+        Ring(const std::size_t capacity, const std::uint32_t thread): slots(new Slot[capacity]), mask(capacity - 1), thread(thread) {}
+
+        void Append(const std::uint64_t task_id, const TracePhase phase, const std::uint64_t time_ns) {
+            Slot& slot = slots[position & mask];
+            const std::uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+            slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.task.store(task_id, std::memory_order_relaxed);
+            slot.stamp.store(time_ns << 3 | static_cast<std::uint64_t>(phase), std::memory_order_relaxed);
+            slot.sequence.store(sequence + 2, std::memory_order_release);
+            position++;
+        }
+
+        void Collect(std::vector<Event>& events) const {
+            for (std::size_t i = 0; i <= mask; i++) {
+                const Slot& slot = slots[i];
+                const std::uint64_t before = slot.sequence.load(std::memory_order_acquire);
+                const std::uint64_t task_id = slot.task.load(std::memory_order_relaxed);
+                const std::uint64_t stamp = slot.stamp.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (before == 0 || (before & 1) || slot.sequence.load(std::memory_order_relaxed) != before)
+                    continue;
+                events.push_back(Event{task_id, static_cast<TracePhase>(stamp & 7), stamp >> 3, thread});
+            }
+        }
+
+        std::unique_ptr<Slot[]> slots;
+        const std::size_t mask;
+        const std::uint32_t thread;
+        std::size_t position = 0;       // owner only
+        std::atomic<bool> owned{true};
+        Ring* next = nullptr;
+    };
+
+    // Rings outlive the tracer for as long as a thread still holds them.
+    struct Registry {
+        std::atomic<Ring*> head{nullptr};
+        std::atomic<std::uint32_t> num_rings{0};
+        std::atomic<bool> alive{true};
+
+        ~Registry() {
+            Ring* ring = head.load();
+            while (ring != nullptr) {
+                Ring* next = ring->next;
+                delete ring;
+                ring = next;
+            }
+        }
+    };
+
+    struct ThreadRings {
+        struct Entry {
+            std::uint64_t tracer_id;
+            std::shared_ptr<Registry> registry;
+            Ring* ring;
+        };
+
+        std::vector<Entry> entries;
+
+        // The registries keep the rings alive, so they can be given up
+        // even after their tracer is gone.
+        ~ThreadRings() {
+            for (const auto& entry : entries)
+                entry.ring->owned.store(false, std::memory_order_release);
+        }
+    };
+
+    // Both wrappers pass Cancel on, so a discarded task still fails its
+    // future; it just leaves no run slice.
+    struct RunSpan {
+        TaskTracer* tracer;
+        Task task;
+        std::uint64_t task_id;
+
+        void operator()() {
+            tracer->Record(task_id, TracePhase::Start);
+            task();
+            tracer->Record(task_id, TracePhase::Finish);
+        }
+
+        void Cancel() {
+            task.Cancel();
+        }
+    };
+
+    struct DequeueMark {
+        TaskTracer* tracer;
+        Task task;
+        std::uint64_t task_id;
+
+        void operator()() {
+            tracer->Record(task_id, TracePhase::Dequeue);
+            task();
+        }
+
+        void Cancel() {
+            task.Cancel();
+        }
+    };
+
+    static std::uint64_t NextTracerId() {
+        static std::atomic<std::uint64_t> next_id{1};
+        return next_id.fetch_add(1);
+    }
+
+    static std::size_t round_up(const std::size_t capacity) {
+        std::size_t result = 2;
+        while (result < capacity)
+            result <<= 1;
+        return result;
+    }
+
+    std::uint64_t Now() const {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count());
+    }
+
+    // The countdown is per thread, so sampling touches nothing shared
+    // until a task is actually picked.
+    std::uint64_t SampleOne(const std::size_t every) {
+        static thread_local std::size_t countdown = 0;
+        if (countdown == 0 || countdown > every)
+            countdown = every;
+        if (--countdown != 0)
+            return 0;
+        const std::uint64_t task_id = next_task.fetch_add(1, std::memory_order_relaxed);
+        Record(task_id, TracePhase::Submit);
+        return task_id;
+    }
+
+    Ring& LocalRing() {
+        static thread_local ThreadRings local;
+        for (const auto& entry : local.entries)
+            if (entry.tracer_id == id)
+                return *entry.ring;
+
+        // Forget tracers that have been destroyed before adding this one.
+        std::vector<ThreadRings::Entry>& entries = local.entries;
+        for (std::size_t i = 0; i < entries.size(); ) {
+            if (!entries[i].registry->alive.load(std::memory_order_relaxed)) {
+                entries[i] = std::move(entries.back());
+                entries.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        entries.push_back(ThreadRings::Entry{id, registry, ClaimRing()});
+        return *entries.back().ring;
+    }
+
+    // A ring given up by an exited thread if there is one, else a new
+    // one. Rings are never unlinked, so the list is safe to walk.
+    Ring* ClaimRing() {
+        for (Ring* ring = registry->head.load(std::memory_order_acquire); ring != nullptr; ring = ring->next) {
+            bool owned = false;
+            if (!ring->owned.load(std::memory_order_relaxed) && ring->owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+                return ring;
+        }
+        Ring* ring = new Ring(ring_capacity, registry->num_rings.fetch_add(1));
+        Ring* head = registry->head.load(std::memory_order_relaxed);
+        do {
+            ring->next = head;
+        } while (!registry->head.compare_exchange_weak(head, ring, std::memory_order_release, std::memory_order_relaxed));
+        return ring;
+    }
+
+    template <class Separate>
+    static void WriteTask(std::ostream& out, const std::uint64_t task_id, const Event* const* phase, Separate& separate) {
+        const Event* submit = phase[static_cast<std::size_t>(TracePhase::Submit)];
+        const Event* enqueue = phase[static_cast<std::size_t>(TracePhase::Enqueue)];
+        const Event* dequeue = phase[static_cast<std::size_t>(TracePhase::Dequeue)];
+        const Event* start = phase[static_cast<std::size_t>(TracePhase::Start)];
+        const Event* finish = phase[static_cast<std::size_t>(TracePhase::Finish)];
+
+        // The worker may take the task before its submitter gets to
+        // record Enqueue, so Enqueue is capped at Dequeue.
+        std::uint64_t enqueued = enqueue ? enqueue->time_ns : 0;
+        if (enqueue && dequeue)
+            enqueued = std::min(enqueued, dequeue->time_ns);
+
+        if (submit && enqueue) {
+            separate();
+            out << "{\"ph\":\"X\",\"name\":\"submit\",\"cat\":\"task\",\"pid\":1,\"tid\":" << submit->thread
+                << ",\"ts\":" << Micros(submit->time_ns) << ",\"dur\":" << Micros(enqueued - submit->time_ns)
+                << ",\"args\":{\"task\":" << task_id << "}}";
+        }
+        if (enqueue && dequeue) {
+            separate();
+            out << "{\"ph\":\"b\",\"name\":\"queued\",\"cat\":\"task\",\"id\":" << task_id << ",\"pid\":1,\"tid\":" << enqueue->thread
+                << ",\"ts\":" << Micros(enqueued) << "}";
+            separate();
+            out << "{\"ph\":\"e\",\"name\":\"queued\",\"cat\":\"task\",\"id\":" << task_id << ",\"pid\":1,\"tid\":" << dequeue->thread
+                << ",\"ts\":" << Micros(dequeue->time_ns) << "}";
+        }
+        if (start && finish) {
+            separate();
+            out << "{\"ph\":\"X\",\"name\":\"run\",\"cat\":\"task\",\"pid\":1,\"tid\":" << start->thread
+                << ",\"ts\":" << Micros(start->time_ns) << ",\"dur\":" << Micros(finish->time_ns - start->time_ns)
+                << ",\"args\":{\"task\":" << task_id;
+            if (enqueue && dequeue)
+                out << ",\"queued_us\":" << Micros(dequeue->time_ns - enqueued);
+            if (dequeue)
+                out << ",\"dequeue_to_start_us\":" << Micros(start->time_ns - std::min(dequeue->time_ns, start->time_ns));
+            out << "}}";
+        }
+        if (submit && start) {
+            separate();
+            out << "{\"ph\":\"s\",\"name\":\"task\",\"cat\":\"task\",\"id\":" << task_id << ",\"pid\":1,\"tid\":" << submit->thread
+                << ",\"ts\":" << Micros(submit->time_ns) << "}";
+            separate();
+            out << "{\"ph\":\"f\",\"bp\":\"e\",\"name\":\"task\",\"cat\":\"task\",\"id\":" << task_id << ",\"pid\":1,\"tid\":" << start->thread
+                << ",\"ts\":" << Micros(start->time_ns) << "}";
+        }
+    }
+
+    // Trace timestamps are microseconds; three decimals keep the
+    // nanoseconds without going through a double.
+    struct Micros {
+        explicit Micros(const std::uint64_t ns): ns(ns) {}
+
+        friend std::ostream& operator<<(std::ostream& out, const Micros& micros) {
+            const std::uint64_t fraction = micros.ns % 1000;
+            out << micros.ns / 1000 << '.' << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10) << static_cast<char>('0' + fraction % 10);
+            return out;
+        }
+
+        std::uint64_t ns;
+    };
+
+    const std::uint64_t id;
+    const std::size_t ring_capacity;
+    const std::chrono::steady_clock::time_point origin;
+    std::shared_ptr<Registry> registry;
+
+    std::atomic<std::size_t> sample_every;
+    std::atomic<std::uint64_t> next_task;
+};
+
+#endif /* TaskTracer_h */
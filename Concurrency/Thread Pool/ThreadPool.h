@@ -9,93 +9,672 @@
 #ifndef ThreadPool_h
 #define ThreadPool_h
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
 #include <iostream>
+#include <limits>
+#include <list>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
-template <class T, class Container = std::deque<T>>
-class BlockingQueue {
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+#include "../Blocking Queue/BlockingQueue.h"
+#include "../Blocking Queue/BoundedMPMCQueue.h"
+#include "../Blocking Queue/SPSCQueue.h"
+#include "../Cache Line/CacheLine.h"
+#include "../Optimistic Linked List/object_pool.h"
+#include "../Spin Wait/SpinWait.h"
+#include "../Stats/Stats.h"
+#include "Cancellation.h"
+#include "Future.h"
+#include "Task.h"
+#include "TaskTracer.h"
+#include "Topology.h"
+
+// Chase-Lev work-stealing deque (Chase & Lev 2005, with the C++11
+// orderings of Le et al. 2013). The owning worker pushes and pops at the
+// bottom without a lock, LIFO, which keeps freshly spawned subtasks hot
+// in its cache; only taking the last element races thieves with a CAS.
+// Thieves take the oldest task from the top with a CAS. Slots hold
+// pointers to tasks boxed in a pool shared by the deques of one
+// ThreadPool, so a thief never reads a task the owner may be writing.
+// The array doubles when full; outgrown ones stay around until the deque
+// goes away, since a thief may still be reading one.
+//
+// Threads other than the owner hand tasks in through PushForeign, a
+// locked list that thieves try first and the owner once its own end is
+// empty. Each deque sits on its own cache lines: owner and thieves of
+// one never share a line with another worker's.
+template <class T>
+class alignas(kCacheLineSize) WorkStealingQueue {
 public:
     
-    explicit BlockingQueue(const size_t& capacity): capacity(capacity), off(false) {}
+    explicit WorkStealingQueue(ObjectPool<T>& boxes): boxes(boxes), array(new Array(kInitialCapacity, nullptr)), foreign_size(0) {}
     
-    void Put(T&& element) {
-        std::unique_lock<std::mutex> lock(mutex);
+    WorkStealingQueue(const WorkStealingQueue& other) = delete;
+    WorkStealingQueue& operator=(const WorkStealingQueue& other) = delete;
+    
+    ~WorkStealingQueue() {
+        Array* current = array.load();
+        for (std::int64_t i = top.load(); i < bottom.load(); i++)
+            boxes.Delete(current->Get(i));
+        while (current) {
+            Array* previous = current->previous;
+            delete current;
+            current = previous;
+        }
+    }
+    
+    // Owner only.
+    void Push(T&& element) {
+        T* box = boxes.New(std::move(element));
+        const std::int64_t b = bottom.load(std::memory_order_relaxed);
+        const std::int64_t t = top.load(std::memory_order_acquire);
+        Array* current = array.load(std::memory_order_relaxed);
+        if (b - t > static_cast<std::int64_t>(current->mask))
+            current = Grow(current, t, b);
+        current->Put(b, box);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+    
+    // Owner only. Every store to bottom is a release, so whatever value
+    // a thief reads, it has seen the tasks below it.
+    bool TryPop(T& result) {
+        const std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array* current = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_relaxed);
         
-        producer_cv.wait(lock, [this](){return box.size()!=capacity || off; });
-        if (off)
-            throw std::bad_exception();
-        box.push_back(std::move(element));
-        consumer_cv.notify_one();
+        T* box = nullptr;
+        if (t <= b) {
+            box = current->Get(b);
+            if (t == b) {
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    box = nullptr;
+                bottom.store(b + 1, std::memory_order_release);
+            }
+        } else {
+            bottom.store(b + 1, std::memory_order_release);
+        }
+        if (box) {
+            Unbox(box, result);
+            return true;
+        }
+        return TakeForeign(result);
     }
     
-    bool Get(T& result) {
-        std::unique_lock<std::mutex> lock(mutex);
+    bool TrySteal(T& result) {
+        if (TakeForeign(result))
+            return true;
+        
+        std::int64_t t = top.load(std::memory_order_acquire);
+        while (true) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const std::int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return false;
+            T* box = array.load(std::memory_order_acquire)->Get(t);
+            if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                Unbox(box, result);
+                return true;
+            }
+        }
+    }
+    
+    // Any thread but the owner.
+    void PushForeign(T&& element) {
+        std::lock_guard<std::mutex> lock(foreign_mutex);
+        foreign.push_back(std::move(element));
+        foreign_size.store(foreign.size(), std::memory_order_relaxed);
+    }
+    
+private:
+    
+    static constexpr std::size_t kInitialCapacity = 64;
+    
+    struct Array {
+        Array(const std::size_t capacity, Array* previous): mask(capacity - 1), slots(new std::atomic<T*>[capacity]), previous(previous) {}
+        
+        T* Get(const std::int64_t index) const {
+            return slots[static_cast<std::size_t>(index) & mask].load(std::memory_order_relaxed);
+        }
         
-        consumer_cv.wait(lock, [this](){return box.size() || off; });
-        if (off && !box.size())
+        void Put(const std::int64_t index, T* box) {
+            slots[static_cast<std::size_t>(index) & mask].store(box, std::memory_order_relaxed);
+        }
+        
+        const std::size_t mask;
+        std::unique_ptr<std::atomic<T*>[]> slots;
+        Array* const previous;
+    };
+    
+    Array* Grow(Array* current, const std::int64_t t, const std::int64_t b) {
+        Array* grown = new Array(2 * (current->mask + 1), current);
+        for (std::int64_t i = t; i < b; i++)
+            grown->Put(i, current->Get(i));
+        array.store(grown, std::memory_order_release);
+        return grown;
+    }
+    
+    void Unbox(T* box, T& result) {
+        result = std::move(*box);
+        boxes.Delete(box);
+    }
+    
+    bool TakeForeign(T& result) {
+        if (!foreign_size.load(std::memory_order_relaxed))
             return false;
+        std::lock_guard<std::mutex> lock(foreign_mutex);
+        if (foreign.empty())
+            return false;
+        result = std::move(foreign.front());
+        foreign.pop_front();
+        foreign_size.store(foreign.size(), std::memory_order_relaxed);
+        return true;
+    }
+    
+    ObjectPool<T>& boxes;
+    
+    // Written by the owner and thieves respectively.
+    alignas(kCacheLineSize) std::atomic<std::int64_t> bottom{0};
+    alignas(kCacheLineSize) std::atomic<std::int64_t> top{0};
+    std::atomic<Array*> array;
+    
+    alignas(kCacheLineSize) std::atomic<std::size_t> foreign_size;
+    std::mutex foreign_mutex;
+    std::deque<T> foreign;
+};
+
+
+// Lanes for Submit(Priority, ...). Untagged Submit/Execute bypass them.
+enum class Priority {
+    Interactive,    // latency-sensitive requests
+    Batch           // bulk background work
+};
+
+static constexpr std::size_t kNumPriorities = 2;
+
+
+// Tasks of all lanes ordered by one deadline each: an explicit one, or
+// the submission time plus the lane's latency budget. Interactive work
+// therefore overtakes batch work, but a batch task that has waited for
+// its budget is due and goes ahead of younger interactive tasks, so no
+// lane starves. Each lane holds at most lane_capacity tasks.
+template <class T>
+class PriorityLanes {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    PriorityLanes(const std::size_t lane_capacity, const Clock::duration batch_budget): lane_capacity(lane_capacity), budget{Clock::duration::zero(), batch_budget}, next_sequence(0), off(false) {
+        for (auto& count : depth)
+            count.store(0);
+    }
+    
+    PriorityLanes(const PriorityLanes& other) = delete;
+    PriorityLanes& operator=(const PriorityLanes& other) = delete;
+    
+    Clock::time_point Deadline(const Priority priority) const {
+        return Clock::now() + budget[static_cast<std::size_t>(priority)];
+    }
+    
+    // Returns false, leaving element untouched, if the lane is full and
+    // wait is false; throws std::bad_exception once shut down.
+    bool Push(const Priority priority, const Clock::time_point deadline, T& element, const bool wait) {
+        const std::size_t lane = static_cast<std::size_t>(priority);
+        std::unique_lock<std::mutex> lock(mutex);
+        if (depth[lane].load(std::memory_order_relaxed) >= lane_capacity) {
+            if (!wait && !off)
+                return false;
+            space_cv[lane].wait(lock, [this, lane](){ return depth[lane].load(std::memory_order_relaxed) < lane_capacity || off; });
+        }
+        if (off)
+            throw std::bad_exception();
         
-        result = std::move(box.front());
-        box.pop_front();
-        producer_cv.notify_one();
+        heap.push_back(Entry{deadline, next_sequence++, lane, std::move(element)});
+        std::push_heap(heap.begin(), heap.end(), Later());
+        depth[lane].fetch_add(1, std::memory_order_relaxed);
         return true;
     }
     
+    // The most urgent task; there must be one.
+    T Pop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::pop_heap(heap.begin(), heap.end(), Later());
+        Entry entry = std::move(heap.back());
+        heap.pop_back();
+        depth[entry.lane].fetch_sub(1, std::memory_order_relaxed);
+        space_cv[entry.lane].notify_one();
+        return std::move(entry.element);
+    }
+    
+    std::size_t Depth(const Priority priority) const {
+        return depth[static_cast<std::size_t>(priority)].load(std::memory_order_relaxed);
+    }
+    
     void Shutdown() {
-        off.store(true);
-        consumer_cv.notify_all();
-        producer_cv.notify_all();
+        std::lock_guard<std::mutex> lock(mutex);
+        off = true;
+        for (auto& cv : space_cv)
+            cv.notify_all();
     }
     
 private:
-    std::size_t capacity;
-    std::atomic_bool off;
+    struct Entry {
+        Clock::time_point deadline;
+        std::uint64_t sequence;
+        std::size_t lane;
+        T element;
+    };
+    
+    // Min-heap on (deadline, sequence): FIFO among equal deadlines.
+    struct Later {
+        bool operator()(const Entry& a, const Entry& b) const {
+            return a.deadline != b.deadline ? a.deadline > b.deadline : a.sequence > b.sequence;
+        }
+    };
+    
+    const std::size_t lane_capacity;
+    const Clock::duration budget[kNumPriorities];
     
-    Container box;
+    std::vector<Entry> heap;
+    std::uint64_t next_sequence;
+    std::atomic<std::size_t> depth[kNumPriorities];
+    bool off;
     
     std::mutex mutex;
-    std::condition_variable producer_cv;
-    std::condition_variable consumer_cv;
+    std::condition_variable space_cv[kNumPriorities];
 };
 
 
-template <class T>
+enum class SchedulingMode {
+    SharedQueue,    // every task goes through one BlockingQueue
+    WorkStealing    // per-worker deques, idle workers steal from each other
+};
+
+
+// What Submit/Execute do when the pool already holds queue_capacity
+// pending tasks.
+enum class BackpressurePolicy {
+    Block,          // wait for space (the original behaviour)
+    Reject,         // throw std::system_error(std::errc::resource_unavailable_try_again)
+    CallerRuns      // run the task right away in the submitting thread
+};
+
+
+// What Shutdown does with tasks that have not started yet.
+enum class ShutdownMode {
+    Drain,          // run them all first (the original behaviour)
+    Discard,        // cancel them: their futures fail with TaskCancelled
+    Deadline        // drain until the deadline, then discard the rest
+};
+
+
+// Where workers run. Pinned pools also assign every worker a NUMA node
+// (CpuTopology), spreading them evenly over the nodes.
+enum class WorkerPlacement {
+    None,           // the OS schedules workers freely (the original behaviour)
+    PinToCore,      // one CPU per worker, round-robin over the nodes
+    PinToNode       // any CPU of the worker's node
+};
+
+
+struct ThreadPoolOptions {
+    static constexpr std::size_t kUnboundedQueue = std::numeric_limits<std::size_t>::max();
+    
+    std::size_t num_threads = 0;                    // 0: one per hardware thread
+    SchedulingMode mode = SchedulingMode::SharedQueue;
+    
+    // Pending tasks allowed, per lane for Submit(Priority, ...). In
+    // work-stealing mode a few concurrent submitters may overshoot it.
+    std::size_t queue_capacity = 0;                 // 0: one slot per worker
+    
+    // A worker never blocks on its own pool: under Block it runs the task
+    // inline instead, which would otherwise deadlock a saturated pool.
+    // Internal forks, continuations and coroutine hops ignore it.
+    BackpressurePolicy backpressure = BackpressurePolicy::Block;
+    
+    std::chrono::microseconds batch_aging = std::chrono::milliseconds(50);  // batch latency budget
+    
+    // In work-stealing mode anything but None groups the deques by node:
+    // idle workers steal on their own node first, and outside threads
+    // submit to a deque of the node they run on.
+    WorkerPlacement placement = WorkerPlacement::None;
+    
+    // Above num_threads the pool is elastic: while more tasks are queued
+    // than threads are alive it adds an unpinned helper, up to
+    // max_threads, which only takes tasks from the queues and exits after
+    // idle_timeout without work.
+    std::size_t max_threads = 0;
+    std::chrono::milliseconds idle_timeout = std::chrono::seconds(1);
+    
+    // Samples Submit and SubmitBefore calls and follows them through the
+    // queue to completion; Execute, Async and internal glue are not
+    // traced. Must outlive the pool.
+    TaskTracer* tracer = nullptr;
+};
+
+
+// ThreadPool::GetStats(); all zero unless built with CONCURRENCY_STATS.
+// Tasks include internal forks and continuations but not lane tickets.
+struct ThreadPoolStats {
+    std::uint64_t submitted = 0;
+    std::uint64_t completed = 0;
+    std::uint64_t steals = 0;
+    std::uint64_t idle_ns = 0;          // summed over all workers and helpers
+    HistogramSnapshot queue_wait;       // from submission to start
+    HistogramSnapshot run_time;
+};
+
+
+// Runs the callable and routes its result or exception into a promise.
+template <class R, class F>
+struct PromiseTask {
+    std::promise<R> promise;
+    F function;
+    
+    void operator()() {
+        try {
+            promise.set_value(function());
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+    
+    void Cancel() {
+        promise.set_exception(std::make_exception_ptr(TaskCancelled()));
+    }
+};
+
+template <class F>
+struct PromiseTask<void, F> {
+    std::promise<void> promise;
+    F function;
+    
+    void operator()() {
+        try {
+            function();
+            promise.set_value();
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+    
+    void Cancel() {
+        promise.set_exception(std::make_exception_ptr(TaskCancelled()));
+    }
+};
+
+template <class R, class F>
+struct FutureTask {
+    std::shared_ptr<FutureState<R>> state;
+    F function;
+    
+    void operator()() {
+        CompleteWith(*state, function);
+    }
+    
+    void Cancel() {
+        state->SetError(std::make_exception_ptr(TaskCancelled()));
+    }
+};
+
+// Execute'd work: nobody waits for it, so cancelling it just drops it.
+template <class F>
+struct DetachedTask {
+    F function;
+    
+    void operator()() {
+        function();
+    }
+    
+    void Cancel() {}
+};
+
+
+// Runs callables of any result type: Submit returns std::future<R>,
+// Async a Future (Future.h), Execute is fire-and-forget. Tasks are stored
+// as Task, so small callables are kept inline and not allocated. T is
+// unused, kept for existing ThreadPool<T> code; TaskQueue is the shared
+// queue of SchedulingMode::SharedQueue, anything with BlockingQueue's
+// Put/TryPut/Get/Shutdown (e.g. BoundedMPMCQueue, which cannot be
+// unbounded). ThreadPoolOptions documents each setting.
+template <class T = void, template <class...> class TaskQueue = BlockingQueue>
 class ThreadPool {
 public:
-    explicit ThreadPool(const size_t num_threads): capacity(num_threads), off(false), workers(num_threads), tasks(num_threads) {
-        for (auto it = workers.begin(); it != workers.end(); it++)
-            *it = std::thread([this](){
-                std::packaged_task<T()> task;
-                while (tasks.Get(task))
-                    task();
+    explicit ThreadPool(const ThreadPoolOptions& options): num_threads(options.num_threads ? options.num_threads : default_num_workers()), capacity(options.queue_capacity ? options.queue_capacity : num_threads), mode(options.mode), backpressure(options.backpressure), max_threads(options.max_threads), idle_timeout(options.idle_timeout), tracer(options.tracer), off(false), workers(num_threads), tasks(capacity), lanes(capacity, options.batch_aging), pending(0), sleeping(0), blocked(0), next_queue(0), live_helpers(0) {
+        Place(options.placement);
+        if (mode == SchedulingMode::WorkStealing) {
+            task_boxes.reset(new ObjectPool<Task>());
+            for (std::size_t i = 0; i < num_threads; i++)
+                local_tasks.emplace_back(new WorkStealingQueue<Task>(*task_boxes));
+            for (std::size_t i = 0; i < num_threads; i++)
+                workers[i] = std::thread([this, i](){ StealingWorker(i); });
+            return;
+        }
+        
+        for (std::size_t i = 0; i < num_threads; i++)
+            workers[i] = std::thread([this, i](){
+                current_worker() = WorkerContext{this, i};
+                Pin(i);
+                Task task;
+                std::uint64_t idle_since = StatsNow();
+                while (tasks.Get(task)) {
+                    counters.idle_ns.Add(StatsNow() - idle_since);
+                    if (Elastic())
+                        pending.fetch_sub(1);
+                    Run(task);
+                    idle_since = StatsNow();
+                }
+                WorkerExited();
             });
     }
     
-    ThreadPool(): ThreadPool(default_num_workers()) {}
+    explicit ThreadPool(const size_t num_threads, const SchedulingMode mode = SchedulingMode::SharedQueue): ThreadPool(make_options(num_threads, mode)) {}
+    
+    ThreadPool(): ThreadPool(ThreadPoolOptions()) {}
+    
+    explicit ThreadPool(const SchedulingMode mode): ThreadPool(make_options(0, mode)) {}
     
     ThreadPool(ThreadPool& other) = delete;
     ThreadPool& operator=(ThreadPool& other) = delete;
     
-    std::future<T> Submit(std::function<T()> task) {
-        std::packaged_task<T()> current_task(task);
-        auto result = current_task.get_future();
-        tasks.Put(std::move(current_task));
+    template <class F, class R = decltype(std::declval<typename std::decay<F>::type&>()())>
+    std::future<R> Submit(F&& task) {
+        PromiseTask<R, typename std::decay<F>::type> current_task{std::promise<R>(), std::forward<F>(task)};
+        auto result = current_task.promise.get_future();
+        const std::uint64_t trace = Sample();
+        Put(TraceRun(trace, Task(std::move(current_task))), trace);
         return result;
     }
     
-    void Shutdown() {
+    // Fire-and-forget: nothing observes the result, so an exception
+    // escaping the callable terminates the program, as with std::thread.
+    template <class F>
+    void Execute(F&& task) {
+        Put(Task(DetachedTask<typename std::decay<F>::type>{std::forward<F>(task)}));
+    }
+    
+    // Goes through PriorityLanes: a small ticket is queued in the task's
+    // place and, on reaching a worker, runs whichever laned task is most
+    // urgent by then.
+    template <class F, class R = decltype(std::declval<typename std::decay<F>::type&>()())>
+    std::future<R> Submit(const Priority priority, F&& task) {
+        return SubmitBefore(priority, lanes.Deadline(priority), std::forward<F>(task));
+    }
+    
+    // An explicit deadline, counted against priority's lane.
+    template <class F, class R = decltype(std::declval<typename std::decay<F>::type&>()())>
+    std::future<R> SubmitBefore(const Priority priority, const std::chrono::steady_clock::time_point deadline, F&& task) {
+        PromiseTask<R, typename std::decay<F>::type> current_task{std::promise<R>(), std::forward<F>(task)};
+        auto result = current_task.promise.get_future();
+        const std::uint64_t trace = Sample();
+        PutPrioritized(priority, deadline, TraceRun(trace, Task(std::move(current_task))), trace);
+        return result;
+    }
+    
+    template <class F>
+    void Execute(const Priority priority, F&& task) {
+        PutPrioritized(priority, lanes.Deadline(priority), Task(DetachedTask<typename std::decay<F>::type>{std::forward<F>(task)}));
+    }
+    
+    // Laned tasks not started yet.
+    std::size_t QueueDepth(const Priority priority) const {
+        return lanes.Depth(priority);
+    }
+    
+    // Continuations of the Future are scheduled back on this pool without
+    // backpressure, so the pool must outlive them. Built as C++20, it can
+    // be co_await'ed, unlike Submit's std::future.
+    template <class F, class R = decltype(std::declval<typename std::decay<F>::type&>()())>
+    Future<R> Async(F&& task) {
+        auto state = std::make_shared<FutureState<R>>(GetExecutor());
+        Put(Task(FutureTask<R, typename std::decay<F>::type>{state, std::forward<F>(task)}));
+        return Future<R>(std::move(state));
+    }
+    
+    // Starts every node of graph on this pool as soon as its predecessors
+    // are done; the Future is ready once all nodes have finished.
+    Future<void> Run(TaskGraph&& graph) {
+        return std::move(graph).Run(GetExecutor());
+    }
+    
+    // Built with CONCURRENCY_STATS every task carries its submission time,
+    // which moves it out of Task's inline storage.
+    ThreadPoolStats GetStats() const {
+        ThreadPoolStats result;
+        result.submitted = counters.submitted.Load();
+        result.completed = counters.completed.Load();
+        result.steals = counters.steals.Load();
+        result.idle_ns = counters.idle_ns.Load();
+        result.queue_wait = counters.queue_wait.Snapshot();
+        result.run_time = counters.run_time.Snapshot();
+        return result;
+    }
+    
+    Executor GetExecutor() const {
+        return Executor{const_cast<ThreadPool*>(this), &ThreadPool::ScheduleContinuation};
+    }
+    
+    // Cancelled once Shutdown starts discarding queued work.
+    CancellationToken GetCancellationToken() const {
+        return cancellation.Token();
+    }
+    
+#if defined(__cpp_impl_coroutine)
+    // co_await pool.Schedule() continues the coroutine on a worker. Like
+    // a continuation it skips backpressure, and it runs inline if the
+    // pool is shutting down.
+    ScheduleAwaiter Schedule() const {
+        return ScheduleAwaiter{GetExecutor()};
+    }
+#endif
+    
+    // The Parallel* calls split [begin, end) into chunks of grain elements
+    // (0: kChunksPerWorker per worker) and fork them in halves, so thieves
+    // take the big halves. The caller runs tasks until every chunk is
+    // done, and the first exception of a chunk is rethrown afterwards.
+    //
+    // Calls function(i) for every i in [begin, end).
+    template <class Index, class F>
+    void ParallelFor(const Index begin, const Index end, const std::size_t grain, F&& function) {
+        if (!(begin < end))
+            return;
+        const std::size_t count = static_cast<std::size_t>(end - begin);
+        const std::size_t chunk = chunk_size(count, grain);
+        
+        ForkJoin((count + chunk - 1) / chunk, [&](const std::size_t first_chunk, const std::size_t last_chunk){
+            const Index first = begin + static_cast<Index>(first_chunk * chunk);
+            const Index last = last_chunk * chunk >= count ? end : begin + static_cast<Index>(last_chunk * chunk);
+            for (Index i = first; i < last; ++i)
+                function(i);
+        });
+    }
+    
+    // reduce(..., map(i), ...) over [begin, end) starting from identity.
+    // Chunks are combined in index order, so reduce only has to be
+    // associative.
+    template <class Index, class R, class Map, class Reduce>
+    R ParallelReduce(const Index begin, const Index end, const std::size_t grain, R identity, Map&& map, Reduce&& reduce) {
+        if (!(begin < end))
+            return identity;
+        const std::size_t count = static_cast<std::size_t>(end - begin);
+        const std::size_t chunk = chunk_size(count, grain);
+        const std::size_t num_chunks = (count + chunk - 1) / chunk;
+        
+        std::vector<R> partial(num_chunks, identity);
+        ParallelFor(std::size_t(0), num_chunks, 1, [&](const std::size_t index){
+            const Index first = begin + static_cast<Index>(index * chunk);
+            const Index last = (index + 1) * chunk >= count ? end : begin + static_cast<Index>((index + 1) * chunk);
+            R value = identity;
+            for (Index i = first; i < last; ++i)
+                value = reduce(std::move(value), map(i));
+            partial[index] = std::move(value);
+        });
+        
+        for (auto& value : partial)
+            identity = reduce(std::move(identity), std::move(value));
+        return identity;
+    }
+    
+    // out[i] = function(first[i]) for random access iterators.
+    template <class InputIt, class OutputIt, class F>
+    OutputIt ParallelTransform(InputIt first, InputIt last, OutputIt out, const std::size_t grain, F&& function) {
+        const auto count = last - first;
+        ParallelFor(decltype(count)(0), count, grain, [&](const decltype(count) i){
+            out[i] = function(first[i]);
+        });
+        return out + count;
+    }
+    
+    // Stops accepting work and joins every thread once the queues are
+    // empty. Internal glue always runs, so nothing waiting on it hangs,
+    // and running tasks are never interrupted; GetCancellationToken() is
+    // cancelled once discarding starts.
+    void Shutdown(const ShutdownMode shutdown_mode = ShutdownMode::Drain, const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) {
+        if (shutdown_mode == ShutdownMode::Discard)
+            Discard();
         off.store(true);
         tasks.Shutdown();
+        lanes.Shutdown();
+        {
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            idle_cv.notify_all();
+            space_cv.notify_all();
+            if (shutdown_mode == ShutdownMode::Deadline && !exited_cv.wait_until(lock, deadline, [this](){ return Exited(); }))
+                Discard();
+        }
         for (auto it = workers.begin(); it != workers.end(); it++)
             it->join();
+        
+        // A helper may be running a task that submits, and so be about to
+        // call MaybeGrow: join outside helpers_mutex. MaybeGrow checks off
+        // under the mutex, so no helper is added after the splice. Splicing
+        // keeps every Helper where its thread can still reach it.
+        std::list<Helper> exiting;
+        {
+            std::lock_guard<std::mutex> lock(helpers_mutex);
+            exiting.splice(exiting.end(), helpers);
+        }
+        for (auto& helper : exiting)
+            helper.thread.join();
     }
     
     ~ThreadPool() {
@@ -105,14 +684,521 @@ public:
     
 private:
     
-    std::size_t capacity;
+    struct WorkerContext {
+        const ThreadPool* pool;
+        std::size_t index;
+    };
+    
+    static WorkerContext& current_worker() {
+        static thread_local WorkerContext context{nullptr, 0};
+        return context;
+    }
+    
+    static ThreadPoolOptions make_options(const std::size_t num_threads, const SchedulingMode mode) {
+        ThreadPoolOptions options;
+        options.num_threads = num_threads;
+        options.mode = mode;
+        return options;
+    }
+    
+    bool InWorker() const {
+        return current_worker().pool == this;
+    }
+    
+    // A sampled task (trace != 0) records Enqueue only if it was queued,
+    // not when Overflow ran or rejected it.
+    void Put(Task&& untracked, const std::uint64_t trace = 0) {
+        Task task = TraceDequeue(trace, Track(std::move(untracked)));
+        bool queued;
+        if (mode == SchedulingMode::WorkStealing) {
+            queued = PutLocal(std::move(task));
+        } else {
+            queued = PushShared(task, backpressure == BackpressurePolicy::Block && !InWorker());
+            if (!queued)
+                Overflow(std::move(task));
+        }
+        if (queued && trace)
+            tracer->Record(trace, TracePhase::Enqueue);
+    }
+    
+    // 0, or the id of a traced submission.
+    std::uint64_t Sample() const {
+        return tracer ? tracer->Sample() : 0;
+    }
+    
+    Task TraceRun(const std::uint64_t trace, Task&& task) const {
+        return trace ? tracer->RecordRun(trace, std::move(task)) : std::move(task);
+    }
+    
+    // Outermost, so Dequeue is stamped before the stats wrapper runs.
+    Task TraceDequeue(const std::uint64_t trace, Task&& task) const {
+        return trace ? tracer->RecordDequeue(trace, std::move(task)) : std::move(task);
+    }
+    
+    bool Elastic() const {
+        return max_threads > num_threads;
+    }
+    
+    // Shared-queue insertion; leaves task untouched if it returns false.
+    bool PushShared(Task& task, const bool wait) {
+        if (!Elastic()) {
+            if (!wait)
+                return tasks.TryPut(std::move(task));
+            tasks.Put(std::move(task));
+            return true;
+        }
+        
+        pending.fetch_add(1);
+        bool pushed = false;
+        try {
+            if (wait) {
+                tasks.Put(std::move(task));
+                pushed = true;
+            } else {
+                pushed = tasks.TryPut(std::move(task));
+            }
+        } catch (...) {
+            pending.fetch_sub(1);
+            throw;
+        }
+        if (!pushed) {
+            pending.fetch_sub(1);
+            return false;
+        }
+        
+        if (sleeping.load()) {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            idle_cv.notify_one();
+        }
+        MaybeGrow();
+        return true;
+    }
+    
+    // The ticket is spawned, never rejected, so every laned task is
+    // matched by exactly one ticket that pops it or a more urgent one.
+    void PutPrioritized(const Priority priority, const std::chrono::steady_clock::time_point deadline, Task&& untracked, const std::uint64_t trace = 0) {
+        Task task = TraceDequeue(trace, Track(std::move(untracked)));
+        const bool wait = backpressure == BackpressurePolicy::Block && !InWorker();
+        if (!lanes.Push(priority, deadline, task, wait)) {
+            Overflow(std::move(task));
+            return;
+        }
+        if (trace)
+            tracer->Record(trace, TracePhase::Enqueue);
+        Spawn(Task([this](){
+            Task task = lanes.Pop();
+            Run(task);
+        }), false);
+    }
+    
+    static constexpr std::size_t kChunksPerWorker = 8;
+    
+    struct ForkJoinState {
+        std::atomic<std::size_t> outstanding{1};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+    };
+    
+    std::size_t chunk_size(const std::size_t count, const std::size_t grain) const {
+        if (grain)
+            return grain;
+        const std::size_t chunks = std::min(count, num_threads * kChunksPerWorker);
+        return (count + chunks - 1) / chunks;
+    }
+    
+    // leaf(first_chunk, last_chunk) is called on disjoint ranges covering
+    // [0, num_chunks); returns once all of them have finished.
+    template <class Leaf>
+    void ForkJoin(const std::size_t num_chunks, const Leaf& leaf) {
+        ForkJoinState state;
+        ForkRange(state, leaf, 0, num_chunks);
+        while (state.outstanding.load(std::memory_order_acquire))
+            if (!RunOneTask())
+                std::this_thread::yield();
+        if (state.error)
+            std::rethrow_exception(state.error);
+    }
+    
+    template <class Leaf>
+    void ForkRange(ForkJoinState& state, const Leaf& leaf, const std::size_t first, std::size_t last) {
+        while (last - first > 1) {
+            const std::size_t middle = first + (last - first) / 2;
+            state.outstanding.fetch_add(1);
+            Spawn(Task([this, &state, &leaf, middle, last](){ ForkRange(state, leaf, middle, last); }));
+            last = middle;
+        }
+        
+        if (!state.failed.load(std::memory_order_relaxed)) {
+            try {
+                leaf(first, last);
+            } catch (...) {
+                if (!state.failed.exchange(true))
+                    state.error = std::current_exception();
+            }
+        }
+        state.outstanding.fetch_sub(1, std::memory_order_release);
+    }
+    
+    // Enqueues an internal task without backpressure; runs it inline if
+    // there is no room or the pool is shutting down.
+    void Spawn(Task&& untracked, const bool track = true) {
+        Task task = track ? Track(std::move(untracked)) : std::move(untracked);
+        if (mode == SchedulingMode::WorkStealing) {
+            pending.fetch_add(1);
+            if (off.load()) {
+                pending.fetch_sub(1);
+                task();
+                return;
+            }
+            PushLocal(std::move(task));
+            return;
+        }
+        
+        if (off.load() || !PushShared(task, false))
+            task();
+    }
+    
+    static void ScheduleContinuation(void* pool, Task&& task) {
+        static_cast<ThreadPool*>(pool)->Spawn(std::move(task));
+    }
+    
+    // Runs one queued task in the calling thread, if there is any.
+    bool RunOneTask() {
+        Task task;
+        if (mode != SchedulingMode::WorkStealing) {
+            if (!tasks.TryGet(task))
+                return false;
+            if (Elastic())
+                pending.fetch_sub(1);
+            Run(task);
+            return true;
+        }
+        
+        bool found = InWorker() ? TakeTask(current_worker().index, task) : false;
+        for (std::size_t i = 0; !found && i < local_tasks.size(); i++)
+            found = local_tasks[i]->TrySteal(task);
+        if (!found)
+            return false;
+        if (!InWorker())
+            counters.steals.Add();
+        
+        TookTask();
+        Run(task);
+        return true;
+    }
+    
+    // Every task taken off a queue goes through here.
+    void Run(Task& task) {
+        if (discarding.load(std::memory_order_relaxed))
+            task.Cancel();
+        else
+            task();
+    }
+    
+    // From here on queued tasks are cancelled instead of run.
+    void Discard() {
+        discarding.store(true);
+        cancellation.Cancel();
+    }
+    
+    // Under idle_mutex.
+    bool Exited() const {
+        return exited_workers == num_threads && !live_helpers.load();
+    }
+    
+    void WorkerExited() {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        exited_workers++;
+        exited_cv.notify_all();
+    }
+    
+    void Overflow(Task&& task) {
+        if (backpressure == BackpressurePolicy::Reject)
+            throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again), "ThreadPool queue is full");
+        task();
+    }
+    
+    // Work-stealing counterpart of a bounded Put: waits, rejects or runs
+    // inline while pending is at capacity.
+    bool ReserveLocal(Task& task) {
+        if (pending.load() < capacity)
+            return true;
+        if (backpressure != BackpressurePolicy::Block || InWorker()) {
+            Overflow(std::move(task));
+            return false;
+        }
+        
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        blocked.fetch_add(1);
+        space_cv.wait(lock, [this](){ return pending.load() < capacity || off.load(); });
+        blocked.fetch_sub(1);
+        return true;
+    }
+    
+    // Tasks submitted from one of our own workers stay on its deque;
+    // external submissions are spread round-robin over all deques.
+    // Returns false if ReserveLocal handed the task to Overflow.
+    bool PutLocal(Task&& task) {
+        if (!ReserveLocal(task))
+            return false;
+        
+        // pending is raised before off is checked: a worker that sees
+        // off and no pending work may leave, so the order matters.
+        pending.fetch_add(1);
+        if (off.load()) {
+            pending.fetch_sub(1);
+            throw std::bad_exception();
+        }
+        PushLocal(std::move(task));
+        return true;
+    }
+    
+    // pending must already account for the task.
+    void PushLocal(Task&& task) {
+        const WorkerContext& context = current_worker();
+        if (context.pool == this)
+            local_tasks[context.index]->Push(std::move(task));
+        else
+            local_tasks[ExternalQueue()]->PushForeign(std::move(task));
+        
+        if (sleeping.load()) {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            idle_cv.notify_one();
+        }
+        MaybeGrow();
+    }
+    
+    std::size_t ExternalQueue() {
+        if (node_workers.size() > 1) {
+            const std::vector<std::size_t>& local = node_workers[CpuTopology::Get().CurrentNode() % node_workers.size()];
+            if (!local.empty())
+                return local[next_queue.fetch_add(1) % local.size()];
+        }
+        return next_queue.fetch_add(1) % local_tasks.size();
+    }
+    
+    bool TakeTask(const std::size_t index, Task& task) {
+        if (local_tasks[index]->TryPop(task))
+            return true;
+        for (std::size_t victim : steal_order[index])
+            if (local_tasks[victim]->TrySteal(task)) {
+                counters.steals.Add();
+                return true;
+            }
+        return false;
+    }
+    
+    // Worker i gets node i % nodes; steal_order[i] lists the other workers
+    // of its node first, each group rotated to start right after i, so
+    // thieves do not all converge on the same victim.
+    void Place(const WorkerPlacement placement) {
+        std::vector<std::size_t> worker_node(num_threads, 0);
+        if (placement != WorkerPlacement::None) {
+            const std::vector<NumaNode>& nodes = CpuTopology::Get().Nodes();
+            node_workers.resize(nodes.size());
+            worker_cpus.resize(num_threads);
+            for (std::size_t i = 0; i < num_threads; i++) {
+                const std::size_t node = i % nodes.size();
+                const std::vector<int>& cpus = nodes[node].cpus;
+                worker_node[i] = node;
+                node_workers[node].push_back(i);
+                if (placement == WorkerPlacement::PinToCore)
+                    worker_cpus[i].push_back(cpus[(i / nodes.size()) % cpus.size()]);
+                else
+                    worker_cpus[i] = cpus;
+            }
+        }
+        
+        steal_order.resize(num_threads);
+        for (std::size_t i = 0; i < num_threads; i++) {
+            for (std::size_t step = 1; step < num_threads; step++)
+                if (worker_node[(i + step) % num_threads] == worker_node[i])
+                    steal_order[i].push_back((i + step) % num_threads);
+            for (std::size_t step = 1; step < num_threads; step++)
+                if (worker_node[(i + step) % num_threads] != worker_node[i])
+                    steal_order[i].push_back((i + step) % num_threads);
+        }
+    }
+    
+    void Pin(const std::size_t index) const {
+        if (!worker_cpus.empty())
+            CpuTopology::PinCurrentThread(worker_cpus[index]);
+    }
+    
+    void TookTask() {
+        pending.fetch_sub(1);
+        if (blocked.load()) {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            space_cv.notify_one();
+        }
+    }
+    
+    void StealingWorker(const std::size_t index) {
+        current_worker() = WorkerContext{this, index};
+        Pin(index);
+        
+        Task task;
+        while (true) {
+            if (TakeTask(index, task)) {
+                TookTask();
+                Run(task);
+                continue;
+            }
+            const std::uint64_t idle_since = StatsNow();
+            if (AwaitWork()) {
+                counters.idle_ns.Add(StatsNow() - idle_since);
+                continue;
+            }
+            
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            sleeping.fetch_add(1);
+            idle_cv.wait(lock, [this](){ return pending.load() || off.load(); });
+            sleeping.fetch_sub(1);
+            counters.idle_ns.Add(StatsNow() - idle_since);
+            if (off.load() && !pending.load())
+                break;
+        }
+        WorkerExited();
+    }
+    
+    // Spins, then yields, while nothing is pending; true if work showed up
+    // meanwhile, false if the caller should park.
+    bool AwaitWork() const {
+        return SpinWait::Until([this](){ return pending.load(std::memory_order_relaxed) != 0; });
+    }
+    
+    struct TrackedTask {
+        ThreadPool* pool;
+        Task task;
+        std::uint64_t submitted;
+        
+        void operator()() {
+            const std::uint64_t started = StatsNow();
+            pool->counters.queue_wait.Record(started - submitted);
+            task();
+            pool->counters.run_time.Record(StatsNow() - started);
+            pool->counters.completed.Add();
+        }
+        
+        void Cancel() {
+            task.Cancel();
+        }
+    };
+    
+    // Without CONCURRENCY_STATS this is the task itself.
+    Task Track(Task&& task) {
+        if constexpr (kStatsEnabled) {
+            counters.submitted.Add();
+            return Task(TrackedTask{this, std::move(task), StatsNow()});
+        } else {
+            return std::move(task);
+        }
+    }
+    
+    struct Counters {
+        ShardedCounter submitted;
+        ShardedCounter completed;
+        ShardedCounter steals;
+        ShardedCounter idle_ns;
+        LatencyHistogram queue_wait;
+        LatencyHistogram run_time;
+    };
+    
+    struct Helper {
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+    
+    void MaybeGrow() {
+        if (!Elastic() || off.load(std::memory_order_relaxed) || num_threads + live_helpers.load(std::memory_order_relaxed) >= max_threads)
+            return;
+        if (pending.load(std::memory_order_relaxed) <= num_threads + live_helpers.load(std::memory_order_relaxed))
+            return;
+        
+        std::lock_guard<std::mutex> lock(helpers_mutex);
+        for (auto it = helpers.begin(); it != helpers.end();) {
+            if (it->done.load()) {
+                it->thread.join();
+                it = helpers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (off.load() || num_threads + live_helpers.load() >= max_threads)
+            return;
+        
+        live_helpers.fetch_add(1);
+        helpers.emplace_back();
+        Helper& helper = helpers.back();
+        helper.thread = std::thread([this, &helper](){ HelperWorker(helper); });
+    }
+    
+    void HelperWorker(Helper& self) {
+        while (true) {
+            if (RunOneTask())
+                continue;
+            const std::uint64_t idle_since = StatsNow();
+            if (AwaitWork()) {
+                counters.idle_ns.Add(StatsNow() - idle_since);
+                continue;
+            }
+            
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            sleeping.fetch_add(1);
+            const bool woken = idle_cv.wait_for(lock, idle_timeout, [this](){ return pending.load() || off.load(); });
+            sleeping.fetch_sub(1);
+            counters.idle_ns.Add(StatsNow() - idle_since);
+            if (!woken || (off.load() && !pending.load()))
+                break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            live_helpers.fetch_sub(1);
+            exited_cv.notify_all();
+        }
+        self.done.store(true);
+    }
+    
+    const std::size_t num_threads;
+    const std::size_t capacity;
+    const SchedulingMode mode;
+    const BackpressurePolicy backpressure;
+    const std::size_t max_threads;
+    const std::chrono::milliseconds idle_timeout;
+    TaskTracer* const tracer;
     
     std::atomic_bool off;
     std::vector<std::thread> workers;
     
-    BlockingQueue<std::packaged_task<T()>> tasks;
+    TaskQueue<Task> tasks;
+    PriorityLanes<Task> lanes;
+    
+    std::unique_ptr<ObjectPool<Task>> task_boxes;       // before local_tasks, which box tasks in it
+    std::vector<std::unique_ptr<WorkStealingQueue<Task>>> local_tasks;
+    // Every submission touches these, so none shares a line with another.
+    alignas(kCacheLineSize) std::atomic<size_t> pending;
+    alignas(kCacheLineSize) std::atomic<size_t> sleeping;
+    alignas(kCacheLineSize) std::atomic<size_t> blocked;
+    alignas(kCacheLineSize) std::atomic<size_t> next_queue;
+    std::vector<std::vector<int>> worker_cpus;
+    std::vector<std::vector<std::size_t>> node_workers;
+    std::vector<std::vector<std::size_t>> steal_order;
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+    std::condition_variable space_cv;
+    std::condition_variable exited_cv;
+    std::size_t exited_workers = 0;
+    
+    std::atomic<bool> discarding{false};
+    CancellationSource cancellation;
+    
+    std::atomic<size_t> live_helpers;
+    std::mutex helpers_mutex;
+    std::list<Helper> helpers;
+    
+    Counters counters;
     
-    std::size_t default_num_workers() {
+    static std::size_t default_num_workers() {
         std::size_t cores = std::thread::hardware_concurrency();
         return cores ? cores : 2;
     }
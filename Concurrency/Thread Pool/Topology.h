@@ -0,0 +1,157 @@
+//
+//  Topology.h
+//  Parallel Programming
+//
+//  Created by Vlad on 14/10/2026.
+//  Copyright © 2026 Codelovin. All rights reserved.
+//
+
+#ifndef Topology_h
+#define Topology_h
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct NumaNode {
+    std::size_t id;             // the kernel's node number
+    std::vector<int> cpus;      // CPUs of the node this process may run on
+};
+
+// NUMA nodes and their CPUs as Linux reports them under
+// /sys/devices/system/node, restricted to the process's affinity mask.
+// Anywhere that information is missing the machine is one node holding
+// every hardware thread, and pinning quietly does nothing.
+class CpuTopology {
+public:
+    static const CpuTopology& Get() {
+        static const CpuTopology topology;
+        return topology;
+    }
+
+    const std::vector<NumaNode>& Nodes() const {
+        return nodes;
+    }
+
+    std::size_t NumNodes() const {
+        return nodes.size();
+    }
+
+    // Index into Nodes() of the node cpu belongs to; 0 if unknown.
+    std::size_t NodeOfCpu(const int cpu) const {
+        if (cpu < 0 || static_cast<std::size_t>(cpu) >= cpu_node.size())
+            return 0;
+        return cpu_node[cpu];
+    }
+
+    // Index into Nodes() of the node the calling thread is running on.
+    std::size_t CurrentNode() const {
+        return nodes.size() > 1 ? NodeOfCpu(CurrentCpu()) : 0;
+    }
+
+    static int CurrentCpu() {
+#if defined(__linux__)
+        return sched_getcpu();
+#else
+        return -1;
+#endif
+    }
+
+    // Restricts the calling thread to cpus; false if that is unsupported
+    // or the kernel refused.
+    static bool PinCurrentThread(const std::vector<int>& cpus) {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        return !cpus.empty() && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpus;
+        return false;
+#endif
+    }
+
+private:
+
+    CpuTopology() {
+        const std::vector<int> allowed = AllowedCpus();
+        for (int node : ParseList(ReadFile("/sys/devices/system/node/online"))) {
+            NumaNode current{static_cast<std::size_t>(node), {}};
+            for (int cpu : ParseList(ReadFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                    current.cpus.push_back(cpu);
+            if (!current.cpus.empty())
+                nodes.push_back(std::move(current));
+        }
+        if (nodes.empty())
+            nodes.push_back(NumaNode{0, allowed});
+
+        for (std::size_t i = 0; i < nodes.size(); i++) {
+            for (int cpu : nodes[i].cpus) {
+                if (static_cast<std::size_t>(cpu) >= cpu_node.size())
+                    cpu_node.resize(cpu + 1, 0);
+                cpu_node[cpu] = i;
+            }
+        }
+    }
+
+    static std::vector<int> AllowedCpus() {
+        std::vector<int> cpus;
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                if (CPU_ISSET(cpu, &set))
+                    cpus.push_back(cpu);
+        }
+#endif
+        if (cpus.empty()) {
+            const unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+            for (unsigned cpu = 0; cpu < cores; cpu++)
+                cpus.push_back(static_cast<int>(cpu));
+        }
+        return cpus;
+    }
+
+    static std::string ReadFile(const std::string& path) {
+        std::ifstream file(path);
+        std::string contents;
+        std::getline(file, contents);
+        return contents;
+    }
+
+    // Kernel list format, e.g. "0-3,8-11".
+    static std::vector<int> ParseList(const std::string& list) {
+        std::vector<int> result;
+        std::stringstream stream(list);
+        std::string range;
+        while (std::getline(stream, range, ',')) {
+            if (range.empty() || !std::isdigit(static_cast<unsigned char>(range[0])))
+                continue;
+            const std::size_t dash = range.find('-');
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int i = first; i <= last; i++)
+                result.push_back(i);
+        }
+        return result;
+    }
+
+    std::vector<NumaNode> nodes;
+    std::vector<std::size_t> cpu_node;
+};
+
+#endif /* Topology_h */